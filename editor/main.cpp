@@ -4,12 +4,18 @@
 #include "text_ui.h"
 #include "editor_config.h"
 #include "screen_buffer.h"
+#include "terminal_writer.h"
+#include "render_thread.h"
+#include "worker_pool.h"
 #include "zlogging.h"
 #include "zstr.h"
 #include "zerrors.h"
 #include "window.h"
 #include "editor_window.h"
+#include "frame_scheduler.h"
+#include "key_sequence_matcher.h"
 #include "width_cache.h"
+#include "shaped_text_cache.h"
 
 #include <chrono>
 #include <cstdio>
@@ -57,9 +63,35 @@ int main() {
         TerminalRawMode raw_terminal_scope;
         FullscreenOn fullscreen_scope; // @todo For some reason this caused weird problems on Windows: the program cannot be rerun - restart of Visual Studio is required.
         HideCursor hide_cursor_scope;
+        std::unique_ptr<CursorShape> cursor_shape_scope;
+        if (getEditorConfig().nativeCursor && (getEditorConfig().cursorShape != 0)) {
+            cursor_shape_scope = std::make_unique<CursorShape>(getEditorConfig().cursorShape);
+        }
         MouseTracking mouse_tracking;
         EventQueue event_queue;
         InputThread input_thread{event_queue};
+        if (getEditorConfig().synchronizedOutput) {
+            auto capabilities = screenBuffer.getTerminalCapabilities();
+            capabilities.synchronizedOutput = querySynchronizedOutput(event_queue);
+            LOG() << "Synchronized output: " << (capabilities.synchronizedOutput ? "supported" : "not supported");
+            screenBuffer.setTerminalCapabilities(capabilities);
+        }
+
+        // Frames are written on a separate thread. Writer is destroyed before terminal modes are restored, so last frame is written first.
+        TerminalWriter terminal_writer;
+        screenBuffer.setTerminalWriter(&terminal_writer);
+
+        // Full repaints of large screens are encoded on all cores.
+        auto coreCount = static_cast<int>(std::thread::hardware_concurrency());
+        WorkerPool worker_pool{std::max(0, coreCount - 1)};
+        screenBuffer.setWorkerPool(&worker_pool);
+
+        // Optionally frames are composed on a separate thread too. It is destroyed before the writer, so it's last frame is written.
+        std::unique_ptr<RenderThread> render_thread;
+        if (getEditorConfig().renderThread) {
+            render_thread = std::make_unique<RenderThread>(screenBuffer);
+        }
+
         OnScreenResize listener{[&](int w, int h) {
             WindowSize windowSize { w, h };
             // TODO: avoid locking mutex in signal handler.
@@ -67,13 +99,8 @@ int main() {
             event_queue.push(windowSize);
         }};
 
-        std::deque<std::string> line_buffer;
-        auto push_line = [&screenBuffer, &line_buffer](std::string line) {
-            line_buffer.push_back(line);
-            while (line_buffer.size() > 0 && static_cast<int>(line_buffer.size()) > screenBuffer.getHeight() - 3) {
-                line_buffer.pop_front();
-            }
-        };
+        // Screen size is kept here, because ScreenBuffer can be used by the render thread.
+        Size screenSize{screenBuffer.getWidth(), screenBuffer.getHeight()};
 
         WindowManager windowManager;
         auto rootWindow = windowManager.getRootWindow();
@@ -83,25 +110,129 @@ int main() {
         auto editorWindow = rootWindow->addChild<EditorWindow>("Editor", Rect{}, true, normalAttributes, invalidAttributes, replacementAttributes);
         windowManager.setFocusedWindow(editorWindow);
 
-        /// Redraws the screen.
-        auto basicRedraw = [&screenBuffer, &line_buffer, &rootWindow]() {
-            screenBuffer.clear(Color::Bright_White);
+        // Actions handled here are interned once.
+        const ActionId boxAction("box");
+        const ActionId loadAction("load");
+        const ActionId quitAction("quit");
+        const ActionId focusOffAction("focus-off");
+        const ActionId focusOnAction("focus-on");
+
+        // Overlay is drawn over all windows in every frame. When it changes, part of the screen it covered is redrawn.
+        Rect overlayRect;   ///< Part of the screen covered by the overlay in the last frame.
+        std::deque<std::string> line_buffer;
+        auto push_line = [&screenSize, &line_buffer, &windowManager, &overlayRect](std::string line) {
+            line_buffer.push_back(line);
+            while (line_buffer.size() > 0 && static_cast<int>(line_buffer.size()) > screenSize.height - 3) {
+                line_buffer.pop_front();
+            }
+            windowManager.invalidate(overlayRect);
+        };
+
+        // When the terminal doesn't keep up with output, link is in low bandwidth mode, which is shown by an indicator in the top-right corner.
+        bool lowBandwidth = false;
+        const std::string lowBandwidthIndicator = " LOW BANDWIDTH ";
+        auto getIndicatorRect = [&screenSize, &lowBandwidthIndicator]() {
+            auto width = static_cast<int>(lowBandwidthIndicator.size());
+            return Rect{Point{screenSize.width - width - 1, 0}, Size{width, 1}};
+        };
+
+        // Keys of a pending key sequence are shown by an indicator in the bottom-left corner.
+        KeySequenceMatcher keySequenceMatcher(std::chrono::milliseconds(getEditorConfig().keySequenceTimeout));
+        std::string keySequenceIndicator;
+        auto getKeySequenceRect = [&screenSize, &keySequenceIndicator]() {
+            return Rect{Point{1, screenSize.height - 1}, Size{static_cast<int>(keySequenceIndicator.size()), 1}};
+        };
+        auto updateKeySequenceIndicator = [&keySequenceMatcher, &keySequenceIndicator, &windowManager, &getKeySequenceRect]() {
+            const auto& pendingKeys = keySequenceMatcher.getPendingKeys();
+            auto indicator = pendingKeys.empty() ? std::string() : " " + pendingKeys + " - ";
+            if (indicator != keySequenceIndicator) {
+                windowManager.invalidate(getKeySequenceRect());
+                keySequenceIndicator = indicator;
+                windowManager.invalidate(getKeySequenceRect());
+            }
+        };
+
+        /// Arenas that snapshots of frames are made in. Each frame keeps it's arena until it is rendered or replaced.
+        FrameArenaPool frameArenas;
+        /// First line of the overlay, and screen size it shows. It is made again only when screen size changes.
+        std::string screenSizeText;
+        Size screenSizeTextSize;
+
+        /// Makes a frame that redraws given region of the screen. Rest of the screen is retained from previous frames.
+        /// Frame uses only snapshots of current state, so it can be drawn on the render thread.
+        /// @param drawOverlay  If false overlay is not drawn. Dirty region must not overlap the overlay then.
+        auto makeFrame = [&screenSize, &line_buffer, &rootWindow, &windowManager, &overlayRect, &lowBandwidth, &lowBandwidthIndicator, &getIndicatorRect, &keySequenceIndicator, &getKeySequenceRect, &frameArenas, &screenSizeText, &screenSizeTextSize](const Region& dirtyRegion, bool drawOverlay) -> RenderThread::Frame {
+            auto arena = frameArenas.acquire();
+            auto rootSnapshot = rootWindow->snapshot(dirtyRegion, *arena);
+            auto cursorPosition = windowManager.getCursorPosition();
+
+            // Shaped texts don't refer to line_buffer, so frame can use them.
+            using ShapedTextVector = ArenaVector<std::shared_ptr<const ShapedText>>;
+            auto overlayLines = arena->create<ShapedTextVector>(ArenaAllocator<std::shared_ptr<const ShapedText>>(*arena));
+            if (drawOverlay) {
+                if (screenSizeText.empty() || (screenSizeTextSize != screenSize)) {
+                    std::stringstream str;
+                    str << "Screen size " << screenSize.width << "x" << screenSize.height;
+                    screenSizeText = str.str();
+                    screenSizeTextSize = screenSize;
+                }
+                overlayLines->reserve(line_buffer.size() + 1);
+                overlayLines->push_back(shapeText(screenSizeText));
+                for (auto& line : line_buffer) {
+                    overlayLines->push_back(shapeText(line));
+                }
 
-            auto canvas = screenBuffer.getCanvas();
-            rootWindow->draw(canvas);
+                overlayRect = Rect{Point{1, 1}, Size{0, std::min(static_cast<int>(overlayLines->size()), screenSize.height - 1)}};
+                for (auto& line : *overlayLines) {
+                    overlayRect.size.width = std::max(overlayRect.size.width, line->width);
+                }
+            }
 
-            std::stringstream str;
-            str << "Screen size " << screenBuffer.getWidth() << "x" << screenBuffer.getHeight();
-            Attributes attributes{Color::White, Color::Black, Style::Normal};
-            canvas.print({1, 1}, str.str(), attributes, attributes, attributes);
+            std::shared_ptr<const ShapedText> indicator;
+            if (lowBandwidth) {
+                indicator = shapeText(lowBandwidthIndicator);
+            }
+            auto indicatorPoint = getIndicatorRect().topLeft;
 
-            int line_number = 2;
-            for (auto& line : line_buffer) {
-                canvas.print({1, line_number}, line, attributes, attributes, attributes);
-                line_number++;
-                if (line_number >= screenBuffer.getHeight())
-                    break;
+            std::shared_ptr<const ShapedText> keySequence;
+            if (!keySequenceIndicator.empty()) {
+                keySequence = shapeText(keySequenceIndicator);
             }
+            auto keySequencePoint = getKeySequenceRect().topLeft;
+
+            // Snapshot and overlay lines are owned by the arena, so frame keeps it.
+            return [screenSize, arena, rootSnapshot, overlayLines, indicator, indicatorPoint, keySequence, keySequencePoint, dirtyRegion, cursorPosition](ScreenBuffer& screenBuffer) {
+                if ((screenSize.width != screenBuffer.getWidth()) || (screenSize.height != screenBuffer.getHeight())) {
+                    screenBuffer.resize(screenSize.width, screenSize.height);
+                }
+
+                auto canvas = screenBuffer.getCanvas();
+                for (auto rect : dirtyRegion.rects()) {
+                    canvas.fill(rect, Color::Bright_White);
+                }
+                rootSnapshot->draw(canvas, dirtyRegion);
+
+                Attributes attributes{Color::White, Color::Black, Style::Normal};
+                int line_number = 1;
+                for (auto& line : *overlayLines) {
+                    canvas.print({1, line_number}, line->graphemes, attributes, attributes, attributes);
+                    line_number++;
+                    if (line_number >= screenBuffer.getHeight())
+                        break;
+                }
+
+                if (indicator) {
+                    Attributes indicatorAttributes{Color::Black, Color::Yellow, Style::Bold};
+                    canvas.print(indicatorPoint, indicator->graphemes, indicatorAttributes, indicatorAttributes, indicatorAttributes);
+                }
+
+                if (keySequence) {
+                    Attributes keySequenceAttributes{Color::Black, Color::Cyan, Style::Bold};
+                    canvas.print(keySequencePoint, keySequence->graphemes, keySequenceAttributes, keySequenceAttributes, keySequenceAttributes);
+                }
+
+                screenBuffer.setCursor(cursorPosition);
+            };
         };
 
         /// Measures all characters missing in textRendererWidthCache.
@@ -109,18 +240,21 @@ int main() {
         ///       Contents of grapheme buffers should be re-rendered after changes that introduce characters with unknown width.
         ///       (So after edits, paste, etc.)
         /// @return False if no characters were missing.
-        auto measureMissingCharacters = [&event_queue, &screenBuffer]() -> bool {
+        auto measureMissingCharacters = [&event_queue, &screenBuffer, &render_thread]() -> bool {
             if (textRendererWidthCache.getMissingWidths().empty()) {
                 return false;
             }
 
-            // We will be sending commands to the terminal directly, so we need to tell to ScreenBuffer that it's view of screen state is invalid.
-            screenBuffer.setFullRepaintNeeded();
+            // Render thread must not use ScreenBuffer while we measure.
+            if (render_thread) {
+                render_thread->waitUntilIdle();
+            }
 
+            // @note measureText() tells ScreenBuffer which cells it has drawn over, so only those will be repainted.
             auto missingWidths = textRendererWidthCache.getMissingWidths(); // @note We make a copy here, because we will be modifying original inside the looop.
             for (auto codePoint : missingWidths) {
                 uint32_t codePoints[] = { codePoint };
-                auto width = measureText(event_queue, codePoints);  // @todo This can fail. What do we do then? Exit, try again, use wcwidth?
+                auto width = measureText(event_queue, screenBuffer, codePoints);  // @todo This can fail. What do we do then? Exit, try again, use wcwidth?
                 LOG() << "Codepoint width: " << codePoint << ", " << width;
                 textRendererWidthCache.setWidth(codePoint, width);
             }
@@ -128,136 +262,260 @@ int main() {
             return true;
         };
 
-        /// Redraws the screen.
-        /// If any graphemes had unknown width it measures them, and re-issues the redraw.
-        auto redraw = [&measureMissingCharacters, &basicRedraw]() {
-            while (true) {
-                basicRedraw();
-                if (!measureMissingCharacters()) {
-                    break;
+        /// Region redrawn by the last submitted frame. If that frame is reclaimed, the region is redrawn by the next one.
+        Region lastFrameRegion;
+
+        /// Redraws invalidated parts of the screen, on the render thread if there is one.
+        /// If any graphemes had unknown width it measures them, and re-makes the frame.
+        /// In low bandwidth mode only the focused window is redrawn while it has changes. Rest of the screen, with the overlay, stays invalid.
+        auto redraw = [&measureMissingCharacters, &makeFrame, &render_thread, &screenBuffer, &windowManager, &lastFrameRegion, &lowBandwidth, &overlayRect]() {
+            if (render_thread && render_thread->reclaimPendingFrame()) {
+                for (auto rect : lastFrameRegion.rects()) {
+                    windowManager.invalidate(rect);
                 }
             }
-        };
 
-        while (true) {
-            redraw();
-            screenBuffer.present();
-
-            auto block = true;
-            while (true) {
-                // Process all events from the queue.
-                auto event = event_queue.poll(block);
-                if (!event)
-                    break;
-                block = false;
-
-                auto e = *event;
-
-                auto focusedWindow = windowManager.getFocusedWindow();
-                auto activeWindow = focusedWindow.value_or(rootWindow);
-                auto inputContextName = activeWindow->getInputContextName();
-
-                auto action = getActionForEvent(inputContextName, e, getEditorConfig());
-                if (action) {
-                    //LOG() << "Action: " << *action;
-                    push_line(*action);
-
-                    if (activeWindow->processAction(*action))
-                        continue;
-
-                    if (*action == "box") {
-                        try {
-                            ZTHROW() << "Bug?";
-                        }
-                        catch (...) {
-                            messageBox(activeWindow, *action);
-                        }
+            auto dirtyRegion = windowManager.takeInvalidRegion();
+            bool drawOverlay = true;
+            auto focusedWindow = windowManager.getFocusedWindow();
+            if (lowBandwidth && focusedWindow && *focusedWindow) {
+                auto focusedRect = (*focusedWindow)->getScreenRect();
+                auto priorityRegion = dirtyRegion.intersect(focusedRect);
+                priorityRegion.subtract(overlayRect);
+                if (!priorityRegion.isEmpty()) {
+                    for (auto rect : priorityRegion.rects()) {
+                        dirtyRegion.subtract(rect);
                     }
-
-                    if (*action == "load") {
-                        editorWindow->loadFile("text.txt");
-                        if (measureMissingCharacters()) {
-                            editorWindow->loadFile("text.txt");
-                        }
+                    for (auto rect : dirtyRegion.rects()) {
+                        windowManager.invalidate(rect);
                     }
+                    dirtyRegion = std::move(priorityRegion);
+                    drawOverlay = false;
+                }
+            }
 
-                    if (*action == "quit") {
-                        messageBox(activeWindow, *action);
-                        redraw();
-                        screenBuffer.present();
-                        std::this_thread::sleep_for(1s);
+            auto frame = makeFrame(dirtyRegion, drawOverlay);
+            while (measureMissingCharacters()) {
+                frame = makeFrame(dirtyRegion, drawOverlay);
+            }
 
-                        LOG() << "Bye.";
-                        return 0;
-                    }
-                }
-                else
-                if (auto keyEvent = std::get_if<KeyPressed>(&e)) {
-                    std::string key;
-                    if (keyEvent->wasCtrlHeld()) {
-                        key = "Ctrl-";
-                    }
-                    key += keyEvent->getUtf8(true);
-                    key += " (" + std::to_string(keyEvent->codePoint) + ")";
-                    push_line(key);
+            if (render_thread) {
+                render_thread->submitFrame(std::move(frame));
+            } else {
+                frame(screenBuffer);
+                screenBuffer.present();
+            }
+            lastFrameRegion = std::move(dirtyRegion);
+        };
 
-                    auto focusedWindow = windowManager.getFocusedWindow();
-                    if (focusedWindow) {
-                        (*focusedWindow)->processTextInput(keyEvent->getUtf8(false));
-                    }
+        /// Performs an action. Active window gets it first, actions it doesn't handle are handled here.
+        /// @return False if editor should quit.
+        auto performAction = [&push_line, &editorWindow, &measureMissingCharacters, &redraw, boxAction, loadAction, quitAction](Window* activeWindow, ActionId action) -> bool {
+            //LOG() << "Action: " << action;
+            push_line(action.getName());
+
+            if (activeWindow->processAction(action))
+                return true;
+
+            if (action == boxAction) {
+                try {
+                    ZTHROW() << "Bug?";
                 }
-                else
-                if (auto windowSize = std::get_if<WindowSize>(&e)) {
-                    if ((windowSize->width != screenBuffer.getWidth()) || (windowSize->height != screenBuffer.getHeight())) {
-                        screenBuffer.resize(windowSize->width, windowSize->height);
-                    }
-                    rootWindow->setRect({{0, 0}, Size{windowSize->width, windowSize->height}});
-                    auto rect = rootWindow->getRect();
-                    rect.topLeft += Size{rect.size.width / 2, 1};
-                    rect.size = Size{rect.size.width / 2 - 1, rect.size.height - 2};
-                    editorWindow->setRect(rect);
+                catch (...) {
+                    messageBox(activeWindow, action.getName());
                 }
-                else
-                if (auto esc = std::get_if<Esc>(&e)) {
-                    std::string message = "Esc ";
-                    message += esc->secondByte;
-                    if (esc->isCSI()) {
-                        message += ZSTR() << " CSI params=" << esc->csiParameterBytes << " inter=" << esc->csiIntermediateBytes << " final=" << esc->csiFinalByte;
-                    }
-                    push_line(message);
+            }
+
+            if (action == loadAction) {
+                editorWindow->loadFile("text.txt");
+                if (measureMissingCharacters()) {
+                    editorWindow->loadFile("text.txt");
+                }
+            }
+
+            if (action == quitAction) {
+                messageBox(activeWindow, action.getName());
+                redraw();
+                std::this_thread::sleep_for(1s);
+
+                LOG() << "Bye.";
+                return false;
+            }
+
+            return true;
+        };
+
+        /// Processes key that isn't part of a key sequence. Action bound to the key is performed, otherwise key is typed into the focused window.
+        /// @return False if editor should quit.
+        auto processKey = [&push_line, &windowManager, &performAction](Window* activeWindow, const KeyPressed& keyEvent) -> bool {
+            auto action = getActionForEvent(activeWindow->getInputContextName(), keyEvent, getEditorConfig());
+            if (action)
+                return performAction(activeWindow, *action);
+
+            std::string key;
+            if (keyEvent.wasCtrlHeld()) {
+                key = "Ctrl-";
+            }
+            key += keyEvent.getUtf8(true);
+            key += " (" + std::to_string(keyEvent.codePoint) + ")";
+            push_line(key);
+
+            auto focusedWindow = windowManager.getFocusedWindow();
+            if (focusedWindow) {
+                (*focusedWindow)->processTextInput(keyEvent.getUtf8(false));
+            }
+            return true;
+        };
+
+        /// Resolves abandoned key sequence: performs its action, or processes its keys one by one if it has none.
+        /// @return False if editor should quit.
+        auto processAbandonedKeys = [&performAction, &processKey](Window* activeWindow, const KeySequenceMatcher::Result& keySequence) -> bool {
+            if (keySequence.abandonedAction)
+                return performAction(activeWindow, *keySequence.abandonedAction);
+
+            for (const auto& keyEvent : keySequence.abandonedKeys) {
+                if (!processKey(activeWindow, keyEvent))
+                    return false;
+            }
+            return true;
+        };
+
+        FrameScheduler frameScheduler(getEditorConfig().maxFps);
+        frameScheduler.requestFrame(FrameScheduler::Clock::now());
+
+        while (true) {
+            auto now = FrameScheduler::Clock::now();
+
+            // Key sequence that timed out is resolved on its own.
+            if (keySequenceMatcher.isPending() && (now >= keySequenceMatcher.getDeadline())) {
+                auto keySequence = keySequenceMatcher.checkTimeout(now);
+                updateKeySequenceIndicator();
+                frameScheduler.requestFrame(now);
+                if (!processAbandonedKeys(windowManager.getFocusedWindow().value_or(rootWindow), keySequence))
+                    return 0;
+            }
+
+            if (getEditorConfig().adaptiveOutput && (screenBuffer.isLinkSaturated() != lowBandwidth)) {
+                lowBandwidth = !lowBandwidth;
+                LOG() << "Low bandwidth mode " << (lowBandwidth ? "on" : "off") << ", throughput: " << screenBuffer.getLinkThroughput() << " B/s";
+                windowManager.invalidate(getIndicatorRect());
+                frameScheduler.requestFrame(now);
+            }
+
+            // In low bandwidth mode frames are not drawn while the previous one is being written, since they would only replace each other.
+            // Main loop checks output again after a short wait.
+            auto waitDeadline = frameScheduler.getWaitDeadline(now);
+            if (lowBandwidth && frameScheduler.isFrameDue(now, event_queue.hasEvents()) && screenBuffer.isOutputBusy()) {
+                waitDeadline = now + 10ms;
+            } else
+            if (frameScheduler.isFrameDue(now, event_queue.hasEvents())) {
+                // Frame that would redraw nothing is skipped, so idle frames cost nothing.
+                if (windowManager.hasInvalidRegion()) {
+                    redraw();
                 }
-                else
-                if (auto error = std::get_if<Error>(&e)) {
-                    std::string message = "Error ";
-                    message += error->msg;
-                    push_line(message);
+                frameScheduler.frameDrawn(now);
+
+                // Deferred parts of the screen are drawn by the next frame.
+                if (windowManager.hasInvalidRegion()) {
+                    frameScheduler.requestFrame(now);
                 }
-                else
-                if (std::get_if<BrokenInput>(&e)) {
-                    LOG() << "Input broken.";
-                    return -1;
+                waitDeadline = frameScheduler.getWaitDeadline(now);
+            }
+
+            // Wait for input, but not longer than until the requested frame is due, or pending key sequence times out.
+            if (keySequenceMatcher.isPending()) {
+                waitDeadline = std::min(waitDeadline, keySequenceMatcher.getDeadline());
+            }
+
+            // Background work is done while waiting, until the next frame is due or input arrives.
+            if (frameScheduler.hasIdleTasks() && !event_queue.hasEvents()) {
+                frameScheduler.runIdleTasks(waitDeadline, [&event_queue]() { return event_queue.hasEvents(); });
+                waitDeadline = std::min(waitDeadline, frameScheduler.getWaitDeadline(FrameScheduler::Clock::now()));
+            }
+            auto event = event_queue.poll(waitDeadline);
+            if (!event)
+                continue;
+
+            // Every event can change what is on the screen.
+            frameScheduler.requestFrame(FrameScheduler::Clock::now());
+
+            auto e = *event;
+
+            auto focusedWindow = windowManager.getFocusedWindow();
+            auto activeWindow = focusedWindow.value_or(rootWindow);
+            auto inputContextName = activeWindow->getInputContextName();
+
+            auto keySequence = keySequenceMatcher.processEvent(inputContextName, e, getEditorConfig().keyMapIndex, FrameScheduler::Clock::now());
+            updateKeySequenceIndicator();
+            if (!processAbandonedKeys(activeWindow, keySequence))
+                return 0;
+            if (keySequence.consumed) {
+                if (keySequence.action && !performAction(activeWindow, *keySequence.action))
+                    return 0;
+                continue;
+            }
+
+            if (auto keyEvent = std::get_if<KeyPressed>(&e)) {
+                if (!processKey(activeWindow, *keyEvent))
+                    return 0;
+                continue;
+            }
+
+            auto action = getActionForEvent(inputContextName, e, getEditorConfig());
+            if (action) {
+                if (!performAction(activeWindow, *action))
+                    return 0;
+            }
+            else
+            if (auto windowSize = std::get_if<WindowSize>(&e)) {
+                // ScreenBuffer is resized by the next frame.
+                screenSize = Size{windowSize->width, windowSize->height};
+                rootWindow->setRect({{0, 0}, Size{windowSize->width, windowSize->height}});
+                auto rect = rootWindow->getRect();
+                rect.topLeft += Size{rect.size.width / 2, 1};
+                rect.size = Size{rect.size.width / 2 - 1, rect.size.height - 2};
+                editorWindow->setRect(rect);
+            }
+            else
+            if (auto esc = std::get_if<Esc>(&e)) {
+                std::string message = "Esc ";
+                message += esc->secondByte;
+                if (esc->isCSI()) {
+                    message += ZSTR() << " CSI params=" << esc->csiParameterBytes << " inter=" << esc->csiIntermediateBytes << " final=" << esc->csiFinalByte;
                 }
-                else
-                if (auto mouseEvent = std::get_if<MouseEvent>(&e)) {
-                    std::string message = "Mouse";
-                    push_line(ZSTR() << "Mouse " << mouseEvent->kind << " x=" << mouseEvent->position.x << " y=" << mouseEvent->position.y);
-
-                    if (mouseEvent->kind == MouseEvent::Kind::LMB) {
-                        auto oldWindow = windowManager.getFocusedWindow();
-                        auto window = rootWindow->getWindowForPoint(mouseEvent->position);
-                        if (window) {
-                            windowManager.setFocusedWindow(*window);
-                            if (oldWindow) {
-                                (*oldWindow)->processAction("focus-off");
-                            }
-                            (*window)->processAction("focus-on");
-                            (*window)->processMouseEvent(*mouseEvent);
+                push_line(message);
+            }
+            else
+            if (auto error = std::get_if<Error>(&e)) {
+                std::string message = "Error ";
+                message += error->msg;
+                push_line(message);
+            }
+            else
+            if (std::get_if<BrokenInput>(&e)) {
+                LOG() << "Input broken.";
+                return -1;
+            }
+            else
+            if (auto mouseEvent = std::get_if<MouseEvent>(&e)) {
+                std::string message = "Mouse";
+                push_line(ZSTR() << "Mouse " << mouseEvent->kind << " x=" << mouseEvent->position.x << " y=" << mouseEvent->position.y);
+
+                if (mouseEvent->kind == MouseEvent::Kind::LMB) {
+                    auto oldWindow = windowManager.getFocusedWindow();
+                    auto window = windowManager.getWindowForPoint(mouseEvent->position);
+                    if (window) {
+                        windowManager.setFocusedWindow(*window);
+                        if (oldWindow) {
+                            (*oldWindow)->processAction(focusOffAction);
                         }
+                        (*window)->processAction(focusOnAction);
+                        (*window)->processMouseEvent(*mouseEvent);
                     }
                 }
-                else {
-                    messageBox(rootWindow, "Default");
-                }
+            }
+            else {
+                messageBox(rootWindow, "Default");
             }
         }
     }
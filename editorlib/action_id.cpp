@@ -0,0 +1,60 @@
+#include "action_id.h"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace terminal_editor {
+
+namespace {
+
+/// Table of all interned action names.
+class ActionNames {
+    std::mutex m_mutex;
+    std::deque<std::string> m_names;                    ///< Name of each action. Deque never moves it's elements, so references to names stay valid.
+    std::unordered_map<std::string, int> m_indexes;     ///< Index of each name in m_names.
+
+public:
+    ActionNames() {
+        intern("");
+    }
+
+    int intern(const std::string& name) {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        auto position = m_indexes.find(name);
+        if (position != m_indexes.end())
+            return position->second;
+
+        auto index = static_cast<int>(m_names.size());
+        m_names.push_back(name);
+        m_indexes.emplace(name, index);
+        return index;
+    }
+
+    const std::string& getName(int index) {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        return m_names[static_cast<size_t>(index)];
+    }
+};
+
+ActionNames& getActionNames() {
+    static ActionNames actionNames;
+    return actionNames;
+}
+
+} // namespace
+
+ActionId::ActionId(const std::string& name)
+    : m_index(getActionNames().intern(name)) {
+}
+
+const std::string& ActionId::getName() const {
+    return getActionNames().getName(m_index);
+}
+
+std::ostream& operator<<(std::ostream& os, ActionId actionId) {
+    return os << actionId.getName();
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+
+namespace terminal_editor {
+
+/// ActionId is an interned name of an editor action.
+/// Names are interned once, when editor config is loaded or action handlers are registered, so comparing actions compares integers.
+/// Ids are small consecutive numbers, so they can index dispatch tables.
+class ActionId {
+    int m_index;    ///< Index of the name in the table of interned names. Zero is the empty name.
+
+public:
+    /// Creates id of the empty action name.
+    ActionId() : m_index(0) {}
+
+    /// Interns given action name.
+    /// @note Thread safe.
+    explicit ActionId(const std::string& name);
+
+    /// Returns index of this action. Indexes are consecutive numbers, starting from zero.
+    int getIndex() const {
+        return m_index;
+    }
+
+    /// Returns name of this action.
+    /// Returned reference is valid until the program exits.
+    const std::string& getName() const;
+
+    bool operator==(ActionId other) const {
+        return m_index == other.m_index;
+    }
+
+    bool operator!=(ActionId other) const {
+        return m_index != other.m_index;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, ActionId actionId);
+};
+
+} // namespace terminal_editor
@@ -3,8 +3,12 @@
 #include "zerrors.h"
 #include "zlogging.h"
 #include "file_utilities.h"
+#include "text_parser.h"
 
+#include <algorithm>
+#include <functional>
 #include <mutex>
+#include <sstream>
 
 #include <nlohmann/json.hpp>
 
@@ -28,6 +32,265 @@ KeyMap::MouseAction from_string(const std::string& mouseAction) {
 template
 KeyMap::MouseAction from_string<KeyMap::MouseAction>(const std::string& mouseAction);
 
+namespace {
+
+/// Returns code point of given key, or nullopt if key is not a single valid code point, so it can't be pressed.
+tl::optional<uint32_t> getKeyCodePoint(const std::string& key) {
+    if (key.empty())
+        return tl::nullopt;
+
+    auto codePointInfo = getFirstCodePoint(key);
+    if (!codePointInfo.valid || (static_cast<size_t>(codePointInfo.consumedInput.size()) != key.size()))
+        return tl::nullopt;
+
+    return codePointInfo.codePoint;
+}
+
+} // namespace
+
+KeyMapIndex::KeyMapIndex(const std::map<std::string, KeyMap>& keyMaps) {
+    for (const auto& kv : keyMaps) {
+        auto& context = m_contexts[kv.first];
+
+        // Key map and it's parents, in order of precedence.
+        std::vector<const KeyMap*> keyMapChain;
+        const KeyMap* keyMap = &kv.second;
+        while (true) {
+            ZASSERT(std::find(keyMapChain.begin(), keyMapChain.end(), keyMap) == keyMapChain.end()) << "Key map is it's own ancestor: " << kv.first;
+            keyMapChain.push_back(keyMap);
+            if (!keyMap->parent)
+                break;
+
+            auto parent = keyMaps.find(*keyMap->parent);
+            ZASSERT(parent != keyMaps.end()) << "Key map not found: " << *keyMap->parent;
+            keyMap = &parent->second;
+        }
+
+        // Bindings are added in order of precedence, so only the first binding of each input is kept.
+        // Action that each action is translated to, by index of the action.
+        std::unordered_map<int, ActionId> nextActions;
+        std::vector<ActionId> translatedActions;
+        int priority = 0;
+        for (auto chainKeyMap : keyMapChain) {
+            for (const auto& binding : chainKeyMap->bindings) {
+                Binding entry{binding.action, priority++};
+
+                if (binding.onAction && nextActions.emplace(binding.onAction->getIndex(), binding.action).second) {
+                    translatedActions.push_back(*binding.onAction);
+                }
+
+                if (binding.key) {
+                    auto codePoint = getKeyCodePoint(*binding.key);
+                    if (codePoint) {
+                        auto& keys = binding.ctrl ? context.ctrlKeys : context.keys;
+                        keys.emplace(*codePoint, entry);
+                    }
+                }
+
+                if (!binding.sequence.empty())
+                    addSequence(context, binding.sequence, entry);
+
+                if (binding.mouseAction)
+                    context.mouseActions.emplace(static_cast<int>(*binding.mouseAction), entry);
+
+                if (binding.csi) {
+                    auto& csiBindings = context.csiSequences[binding.csi->finalByte];
+                    auto sameParams = [&binding](const CsiBinding& csiBinding) { return csiBinding.params == binding.csi->params; };
+                    if (std::none_of(csiBindings.begin(), csiBindings.end(), sameParams))
+                        csiBindings.push_back(CsiBinding{binding.csi->params, entry});
+                }
+
+                if (binding.ss2)
+                    context.ss2Characters.emplace(*binding.ss2, entry);
+
+                if (binding.ss3)
+                    context.ss3Characters.emplace(*binding.ss3, entry);
+            }
+        }
+
+        // Follow translations of each action to the end of the chain.
+        for (auto firstAction : translatedActions) {
+            std::vector<ActionId> matchedActions{firstAction};
+            auto action = firstAction;
+            while (true) {
+                auto nextAction = nextActions.find(action.getIndex());
+                if (nextAction == nextActions.end()) {
+                    context.translations.emplace(firstAction.getIndex(), action);
+                    break;
+                }
+
+                action = nextAction->second;
+                if (std::find(matchedActions.begin(), matchedActions.end(), action) != matchedActions.end()) {
+                    std::stringstream ss;
+                    for (auto matchedAction : matchedActions) {
+                        ss << matchedAction << " -> ";
+                    }
+                    ss << "-> " << action;
+                    context.circularChains.emplace(firstAction.getIndex(), ss.str());
+                    break;
+                }
+                matchedActions.push_back(action);
+            }
+        }
+    }
+}
+
+tl::optional<ActionId> KeyMapIndex::findKeyAction(const std::string& contextName, uint32_t codePoint, tl::optional<uint32_t> ctrlCodePoint) const {
+    auto context = findContext(contextName);
+    if (!context)
+        return tl::nullopt;
+
+    const Binding* binding = nullptr;
+    auto key = context->keys.find(codePoint);
+    if (key != context->keys.end())
+        binding = &key->second;
+
+    if (ctrlCodePoint) {
+        auto ctrlKey = context->ctrlKeys.find(*ctrlCodePoint);
+        if ((ctrlKey != context->ctrlKeys.end()) && (!binding || (ctrlKey->second.priority < binding->priority)))
+            binding = &ctrlKey->second;
+    }
+
+    return translate(*context, binding);
+}
+
+tl::optional<int> KeyMapIndex::findSequenceNode(const std::string& contextName, int node, uint32_t codePoint, tl::optional<uint32_t> ctrlCodePoint) const {
+    auto context = findContext(contextName);
+    if (!context || (node >= static_cast<int>(context->sequenceNodes.size())))
+        return tl::nullopt;
+
+    const auto& sequenceNode = context->sequenceNodes[node];
+    const SequenceEdge* edge = nullptr;
+    auto key = sequenceNode.keys.find(codePoint);
+    if (key != sequenceNode.keys.end())
+        edge = &key->second;
+
+    if (ctrlCodePoint) {
+        auto ctrlKey = sequenceNode.ctrlKeys.find(*ctrlCodePoint);
+        if ((ctrlKey != sequenceNode.ctrlKeys.end()) && (!edge || (ctrlKey->second.priority < edge->priority)))
+            edge = &ctrlKey->second;
+    }
+
+    if (!edge)
+        return tl::nullopt;
+    return edge->node;
+}
+
+tl::optional<ActionId> KeyMapIndex::findSequenceAction(const std::string& contextName, int node) const {
+    auto context = findContext(contextName);
+    if (!context || (node >= static_cast<int>(context->sequenceNodes.size())))
+        return tl::nullopt;
+
+    const auto& binding = context->sequenceNodes[node].binding;
+    return translate(*context, binding ? &*binding : nullptr);
+}
+
+bool KeyMapIndex::isSequencePrefix(const std::string& contextName, int node) const {
+    auto context = findContext(contextName);
+    if (!context || (node >= static_cast<int>(context->sequenceNodes.size())))
+        return false;
+
+    const auto& sequenceNode = context->sequenceNodes[node];
+    return !sequenceNode.keys.empty() || !sequenceNode.ctrlKeys.empty();
+}
+
+tl::optional<ActionId> KeyMapIndex::findMouseAction(const std::string& contextName, KeyMap::MouseAction mouseAction) const {
+    auto context = findContext(contextName);
+    if (!context)
+        return tl::nullopt;
+
+    auto binding = context->mouseActions.find(static_cast<int>(mouseAction));
+    return translate(*context, (binding != context->mouseActions.end()) ? &binding->second : nullptr);
+}
+
+tl::optional<ActionId> KeyMapIndex::findCsiAction(const std::string& contextName, char finalByte, gsl::span<const int> params) const {
+    auto context = findContext(contextName);
+    if (!context)
+        return tl::nullopt;
+
+    auto csiBindings = context->csiSequences.find(finalByte);
+    if (csiBindings == context->csiSequences.end())
+        return tl::nullopt;
+
+    for (const auto& csiBinding : csiBindings->second) {
+        if (std::equal(csiBinding.params.begin(), csiBinding.params.end(), params.begin(), params.end()))
+            return translate(*context, &csiBinding.binding);
+    }
+    return tl::nullopt;
+}
+
+tl::optional<ActionId> KeyMapIndex::findSsAction(const std::string& contextName, bool ss3, const std::string& character) const {
+    auto context = findContext(contextName);
+    if (!context)
+        return tl::nullopt;
+
+    const auto& characters = ss3 ? context->ss3Characters : context->ss2Characters;
+    auto binding = characters.find(character);
+    return translate(*context, (binding != characters.end()) ? &binding->second : nullptr);
+}
+
+void KeyMapIndex::addSequence(Context& context, const std::vector<KeyMap::KeyStroke>& sequence, const Binding& binding) {
+    // Sequences with keys that are not single code points can never be pressed.
+    std::vector<uint32_t> codePoints;
+    for (const auto& keyStroke : sequence) {
+        auto codePoint = getKeyCodePoint(keyStroke.key);
+        if (!codePoint)
+            return;
+        codePoints.push_back(*codePoint);
+    }
+
+    if (context.sequenceNodes.empty())
+        context.sequenceNodes.emplace_back();
+
+    // Nodes are referred to by index, because adding nodes invalidates references.
+    int node = 0;
+    for (size_t i = 0; i < sequence.size(); ++i) {
+        auto& edges = sequence[i].ctrl ? context.sequenceNodes[node].ctrlKeys : context.sequenceNodes[node].keys;
+        auto edge = edges.find(codePoints[i]);
+        if (edge != edges.end()) {
+            node = edge->second.node;
+            continue;
+        }
+
+        auto nextNode = static_cast<int>(context.sequenceNodes.size());
+        edges.emplace(codePoints[i], SequenceEdge{nextNode, binding.priority});
+        context.sequenceNodes.emplace_back();
+        node = nextNode;
+    }
+
+    // Bindings are added in order of precedence, so only the first binding of a sequence is kept.
+    auto& sequenceNode = context.sequenceNodes[node];
+    if (!sequenceNode.binding)
+        sequenceNode.binding = binding;
+}
+
+const KeyMapIndex::Context* KeyMapIndex::findContext(const std::string& contextName) const {
+    auto context = m_contexts.find(contextName);
+    if (context == m_contexts.end()) {
+        context = m_contexts.find("global");
+        if (context == m_contexts.end())
+            return nullptr;
+    }
+    return &context->second;
+}
+
+tl::optional<ActionId> KeyMapIndex::translate(const Context& context, const Binding* binding) {
+    if (!binding)
+        return tl::nullopt;
+
+    auto actionIndex = binding->action.getIndex();
+    auto circularChain = context.circularChains.find(actionIndex);
+    if (circularChain != context.circularChains.end()) {
+        ZTHROW() << "Circular action chain: " << circularChain->second;
+    }
+
+    auto translation = context.translations.find(actionIndex);
+    if (translation != context.translations.end())
+        return translation->second;
+
+    return binding->action;
+}
+
 /// Returns true if given json object has given key.
 /// Value under the key does not matter (it can also be null).
 bool hasKey(const nlohmann::json& j, const std::string& key) {
@@ -54,10 +317,22 @@ void from_json(const nlohmann::json& json, KeyMap::CsiSequence& csi) {
     csi.finalByte = finalByte[0];
 }
 
+/// Serializes KeyStroke to json.
+void to_json(nlohmann::json& json, const KeyMap::KeyStroke& keyStroke) {
+    json["key"] = keyStroke.key;
+    json["ctrl"] = keyStroke.ctrl;
+}
+
+/// Deserializes KeyStroke from json.
+void from_json(const nlohmann::json& json, KeyMap::KeyStroke& keyStroke) {
+    keyStroke.key = json["key"].get<std::string>();
+    keyStroke.ctrl = json.value("ctrl", false);
+}
+
 /// Serializes KeyBinding to json.
 void to_json(nlohmann::json& json, const KeyMap::KeyBinding& keyBinding) {
     if (keyBinding.onAction) {
-        json["onAction"] = *keyBinding.onAction;
+        json["onAction"] = keyBinding.onAction->getName();
     }
 
     if (keyBinding.key) {
@@ -65,6 +340,10 @@ void to_json(nlohmann::json& json, const KeyMap::KeyBinding& keyBinding) {
     }
     json["ctrl"] = keyBinding.ctrl;
 
+    if (!keyBinding.sequence.empty()) {
+        json["sequence"] = keyBinding.sequence;
+    }
+
     if (keyBinding.mouseAction) {
         json["mouseAction"] = to_string(*keyBinding.mouseAction);
     }
@@ -80,20 +359,24 @@ void to_json(nlohmann::json& json, const KeyMap::KeyBinding& keyBinding) {
         json["ss3"] = *keyBinding.ss3;
     }
 
-    json["action"] = keyBinding.action;
+    json["action"] = keyBinding.action.getName();
 }
 
 /// Deserializes KeyBinding from json.
 void from_json(const nlohmann::json& json, KeyMap::KeyBinding& keyBinding) {
     keyBinding.onAction = tl::nullopt;
     if (hasKey(json, "onAction"))
-        keyBinding.onAction = json["onAction"].get<std::string>();
+        keyBinding.onAction = ActionId(json["onAction"].get<std::string>());
 
     keyBinding.key = tl::nullopt;
     if (hasKey(json, "key"))
         keyBinding.key = json["key"].get<std::string>();
     keyBinding.ctrl = json.value("ctrl", false);
 
+    keyBinding.sequence.clear();
+    if (hasKey(json, "sequence"))
+        json["sequence"].get_to(keyBinding.sequence);
+
     keyBinding.mouseAction = tl::nullopt;
     if (hasKey(json, "mouseAction"))
         keyBinding.mouseAction = from_string<KeyMap::MouseAction>(json["mouseAction"].get<std::string>());
@@ -108,7 +391,7 @@ void from_json(const nlohmann::json& json, KeyMap::KeyBinding& keyBinding) {
     if (hasKey(json, "ss3"))
         keyBinding.ss3 = json["ss3"].get<std::string>();
 
-    keyBinding.action = json["action"].get<std::string>();
+    keyBinding.action = ActionId(json["action"].get<std::string>());
 }
 
 /// Serializes KeyMap to json.
@@ -133,6 +416,13 @@ void from_json(const nlohmann::json& json, KeyMap& keyMap) {
 void to_json(nlohmann::json& json, const EditorConfig& editorConfig) {
     json["tabWidth"] = editorConfig.tabWidth;
     json["mouse-wheel-scroll-lines"] = editorConfig.mouseWheelScrollLines;
+    json["max-fps"] = editorConfig.maxFps;
+    json["synchronized-output"] = editorConfig.synchronizedOutput;
+    json["native-cursor"] = editorConfig.nativeCursor;
+    json["cursor-shape"] = editorConfig.cursorShape;
+    json["render-thread"] = editorConfig.renderThread;
+    json["adaptive-output"] = editorConfig.adaptiveOutput;
+    json["key-sequence-timeout"] = editorConfig.keySequenceTimeout;
     
     json["keyMaps"] = editorConfig.keyMaps;
 }
@@ -140,10 +430,18 @@ void to_json(nlohmann::json& json, const EditorConfig& editorConfig) {
 /// Deserializes EditorConfig from json.
 void from_json(const nlohmann::json& json, EditorConfig& editorConfig) {
     editorConfig.tabWidth = json.value("tabWidth", editorConfig.tabWidth);
+    editorConfig.maxFps = json.value("max-fps", editorConfig.maxFps);
+    editorConfig.synchronizedOutput = json.value("synchronized-output", editorConfig.synchronizedOutput);
+    editorConfig.nativeCursor = json.value("native-cursor", editorConfig.nativeCursor);
+    editorConfig.cursorShape = json.value("cursor-shape", editorConfig.cursorShape);
+    editorConfig.renderThread = json.value("render-thread", editorConfig.renderThread);
+    editorConfig.adaptiveOutput = json.value("adaptive-output", editorConfig.adaptiveOutput);
+    editorConfig.keySequenceTimeout = json.value("key-sequence-timeout", editorConfig.keySequenceTimeout);
     editorConfig.keyMaps = json.value("keyMaps", editorConfig.keyMaps);
     for (auto& kv : editorConfig.keyMaps) {
         kv.second.name = kv.first;
     }
+    editorConfig.keyMapIndex = KeyMapIndex(editorConfig.keyMaps);
 }
 
 /// Used to load editor config from default location at program start. @todo Remove this feature later.
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "action_id.h"
+
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <tl/optional.hpp>
+#include <gsl/span>
 
 namespace terminal_editor {
 
@@ -23,10 +28,17 @@ struct KeyMap {
         char finalByte;             ///< Final byte of the CSI sequence.
     };
 
+    /// One key of a key sequence.
+    struct KeyStroke {
+        std::string key;            ///< UTF-8 key that should be pressed.
+        bool ctrl;                  ///< True if Control should also be pressed.
+    };
+
     /// KeyBinding specifies what action should be performed when some input is given.
     /// The action will match if any of the following matches:
     ///   - onAction,
     ///   - keyboard key,
+    ///   - key sequence,
     ///   - mouse event,
     ///   - CSI sequence,
     ///   - SS2 character,
@@ -35,11 +47,13 @@ struct KeyMap {
     ///        So once any action was resolved, only onAction bindings matter. All other bindings are ignored.
     ///        This makes processing of hierarchical KeyMaps sane.
     struct KeyBinding {
-        tl::optional<std::string> onAction;    ///< Action that should be translated into another action.
+        tl::optional<ActionId> onAction;       ///< Action that should be translated into another action.
 
         tl::optional<std::string> key;         ///< UTF-8 key that should pressed.
         bool ctrl;                             ///< True if Control should also be pressed (used only for keys).
 
+        std::vector<KeyStroke> sequence;       ///< Keys that should be pressed one after another, like Ctrl-X Ctrl-S. Empty if binding is not a key sequence.
+
         tl::optional<MouseAction> mouseAction; ///< Mouse action that should be pressed.
 
         tl::optional<CsiSequence> csi;         ///< CSI sequence that is mapped.
@@ -47,7 +61,7 @@ struct KeyMap {
         tl::optional<std::string> ss2;         ///< Key from alternative SS2 character set.
         tl::optional<std::string> ss3;         ///< Key from alternative SS3 character set.
 
-        std::string action;                    ///< Action for this shortcut.
+        ActionId action;                       ///< Action for this shortcut.
     };
 
     std::vector<KeyBinding> bindings;
@@ -57,11 +71,113 @@ std::string to_string(KeyMap::MouseAction mouseAction);
 template<typename T>
 KeyMap::MouseAction from_string(const std::string& mouseAction);
 
+/// KeyMapIndex is KeyMaps compiled into hash tables, so finding action bound to an input takes a couple of lookups.
+/// Each context (name of a key map) has tables of bindings of it's key map and all it's parents.
+/// Earlier bindings have precedence over later ones, and bindings of a key map over bindings of it's parents.
+/// Actions are translated by onAction bindings to the end of the chain in advance.
+/// Key sequences of each context are compiled into a trie, so each key of a sequence takes a single lookup.
+class KeyMapIndex {
+    /// Action bound to an input.
+    struct Binding {
+        ActionId action;
+        int priority;   ///< Position of the binding in the context. Lower is first.
+    };
+
+    /// Action bound to a CSI sequence with given parameters.
+    struct CsiBinding {
+        std::vector<int> params;
+        Binding binding;
+    };
+
+    /// Edge of the key sequence trie.
+    struct SequenceEdge {
+        int node;       ///< Index of the node the edge leads to.
+        int priority;   ///< Priority of the first binding that uses this edge.
+    };
+
+    /// Node of the key sequence trie.
+    struct SequenceNode {
+        std::unordered_map<uint32_t, SequenceEdge> keys;       ///< Next nodes by code point of the key pressed without ctrl.
+        std::unordered_map<uint32_t, SequenceEdge> ctrlKeys;   ///< Next nodes by reconstructed code point of the key pressed with ctrl.
+        tl::optional<Binding> binding;                          ///< Binding of the sequence that ends at this node.
+    };
+
+    struct Context {
+        std::unordered_map<uint32_t, Binding> keys;                     ///< Bindings of keys pressed without ctrl, by code point.
+        std::unordered_map<uint32_t, Binding> ctrlKeys;                 ///< Bindings of keys pressed with ctrl, by reconstructed code point.
+        std::unordered_map<int, Binding> mouseActions;                  ///< Bindings of mouse actions, by KeyMap::MouseAction.
+        std::unordered_map<char, std::vector<CsiBinding>> csiSequences; ///< Bindings of CSI sequences, by final byte. There are only a few for each final byte.
+        std::unordered_map<std::string, Binding> ss2Characters;         ///< Bindings of SS2 characters.
+        std::unordered_map<std::string, Binding> ss3Characters;         ///< Bindings of SS3 characters.
+        std::unordered_map<int, ActionId> translations;                 ///< Action at the end of the translation chain, by index of the first action. Only for actions that are translated.
+        std::unordered_map<int, std::string> circularChains;            ///< Description of translation chains that loop, by index of the first action.
+        std::vector<SequenceNode> sequenceNodes;                        ///< Trie of key sequences. First node is the root. Empty if there are no key sequences.
+    };
+
+    std::unordered_map<std::string, Context> m_contexts;
+
+public:
+    KeyMapIndex() = default;
+
+    /// Compiles given key maps.
+    /// Throws if parent of a key map is not found, or if parents form a loop.
+    explicit KeyMapIndex(const std::map<std::string, KeyMap>& keyMaps);
+
+    /// Returns action bound to a key in given context. Falls back to "global" context if given one is not found.
+    /// Throws if translations of the action form a loop.
+    /// @param codePoint        Code point of the key.
+    /// @param ctrlCodePoint    Code point reconstructed from the key, if Control was held.
+    tl::optional<ActionId> findKeyAction(const std::string& contextName, uint32_t codePoint, tl::optional<uint32_t> ctrlCodePoint) const;
+
+    /// Returns action bound to a mouse action in given context.
+    tl::optional<ActionId> findMouseAction(const std::string& contextName, KeyMap::MouseAction mouseAction) const;
+
+    /// Returns action bound to a CSI sequence without intermediate bytes in given context.
+    /// Doesn't allocate memory.
+    /// @param params   Parameters of the sequence. Empty parameters are zeros.
+    tl::optional<ActionId> findCsiAction(const std::string& contextName, char finalByte, gsl::span<const int> params) const;
+
+    /// Returns action bound to a SS2 or SS3 character in given context.
+    /// @param ss3      True for SS3 characters, false for SS2 characters.
+    tl::optional<ActionId> findSsAction(const std::string& contextName, bool ss3, const std::string& character) const;
+
+    /// Returns node of the key sequence trie that is reached from given node by a key. Node 0 is the root, where every sequence starts.
+    /// @param ctrlCodePoint    Code point reconstructed from the key, if Control was held.
+    /// @return Index of the node, or nullopt if no key sequence continues with given key.
+    tl::optional<int> findSequenceNode(const std::string& contextName, int node, uint32_t codePoint, tl::optional<uint32_t> ctrlCodePoint) const;
+
+    /// Returns action of the key sequence that ends at given node.
+    /// Throws if translations of the action form a loop.
+    tl::optional<ActionId> findSequenceAction(const std::string& contextName, int node) const;
+
+    /// Returns true if longer key sequences start with the sequence that ends at given node.
+    bool isSequencePrefix(const std::string& contextName, int node) const;
+
+private:
+    /// Returns context of given name, or "global" context if it is not found, or nullptr if neither is found.
+    const Context* findContext(const std::string& contextName) const;
+
+    /// Adds key sequence to the trie of given context.
+    /// Sequences with keys that are not single code points are ignored, like keys of other bindings.
+    static void addSequence(Context& context, const std::vector<KeyMap::KeyStroke>& sequence, const Binding& binding);
+
+    /// Returns action of given binding translated to the end of the chain.
+    static tl::optional<ActionId> translate(const Context& context, const Binding* binding);
+};
+
 /// Structure that contains editor configuration.
 struct EditorConfig {
     int tabWidth = 4;                       ///< How many characters should tabulator take on screen.
     int mouseWheelScrollLines = 3;         ///< How many lines should a mouse wheel scroll move by.
+    int maxFps = 60;                       ///< Maximal number of frames drawn per second. Zero means no limit.
+    bool synchronizedOutput = true;        ///< If true, and terminal supports synchronized output (DEC mode 2026), frames are drawn atomically.
+    bool nativeCursor = false;             ///< If true, terminal's hardware cursor is used as the text cursor. Otherwise cursor is painted.
+    int cursorShape = 0;                   ///< DECSCUSR shape of the hardware cursor: 0 - terminal's default, 1/2 - block, 3/4 - underline, 5/6 - bar (odd values blink).
+    bool renderThread = false;             ///< If true, frames are composed and encoded on a separate thread, so slow drawing doesn't delay input handling.
+    bool adaptiveOutput = true;            ///< If true, when the terminal doesn't keep up with output, focused window is redrawn first and other changes are deferred.
     std::map<std::string, KeyMap> keyMaps; ///< KeyMaps that define keyboard/mouse shortcuts.
+    int keySequenceTimeout = 1000;         ///< Milliseconds to wait for the next key of a key sequence. After that, keys pressed so far are resolved on their own.
+    KeyMapIndex keyMapIndex;               ///< keyMaps compiled for fast lookup. Rebuilt when config is loaded.
 };
 
 /// Returns editor configuration.
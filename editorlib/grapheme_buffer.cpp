@@ -25,6 +25,7 @@ void GraphemeBuffer::loadFile(const std::string& fileName) {
 
 void GraphemeBuffer::rerenderAllLines() {
     renderedLines.resize(m_textBuffer.getNumberOfLines());
+    lineColumns.resize(m_textBuffer.getNumberOfLines());
     for (int row = 0; row < m_textBuffer.getNumberOfLines(); ++row) {
         rerenderLine(row);
     }
@@ -35,6 +36,15 @@ void GraphemeBuffer::rerenderLine(int row) {
     auto codePointInfos = parseLine(line);
     auto renderedLine = renderLine(codePointInfos);
     renderedLines[row] = renderedLine;
+
+    auto& columns = lineColumns[row];
+    columns.resize(renderedLine.size() + 1);
+    int column = 0;
+    for (size_t i = 0; i < renderedLine.size(); ++i) {
+        columns[i] = column;
+        column += renderedLine[i].width;
+    }
+    columns.back() = column;
 }
 
 int GraphemeBuffer::getNumberOfLines() const {
@@ -43,12 +53,11 @@ int GraphemeBuffer::getNumberOfLines() const {
 }
 
 int GraphemeBuffer::getLongestLineLength() const {
-    // @todo This is a stub implementation.
-    auto longestPos = std::max_element(renderedLines.begin(), renderedLines.end(), [](const auto& renderedLine0, const auto& renderedLine1) {
-        return getRenderedWidth(renderedLine0) < getRenderedWidth(renderedLine1);
+    auto longestPos = std::max_element(lineColumns.begin(), lineColumns.end(), [](const auto& columns0, const auto& columns1) {
+        return columns0.back() < columns1.back();
     });
-    ZASSERT(longestPos != renderedLines.end());
-    return static_cast<int>(getRenderedWidth(*longestPos));
+    ZASSERT(longestPos != lineColumns.end());
+    return longestPos->back();
 }
 
 gsl::span<const Grapheme> GraphemeBuffer::getLine(int row) const {
@@ -79,9 +88,33 @@ gsl::span<const Grapheme> GraphemeBuffer::getLineRange(int row, int colStart, in
     return { &line[colStart], colEnd - colStart };
 }
 
-Point GraphemeBuffer::positionToPoint(Position position) {
-    auto lineRange = getLineRange(position.row, 0, position.column);
-    return { getRenderedWidth(lineRange), position.row };
+gsl::span<const Grapheme> GraphemeBuffer::getScreenRange(int row, int columnStart, int columnEnd, int& firstColumn) const {
+    firstColumn = columnStart;
+    auto line = getLine(row);
+    if (line.empty())
+        return {};
+
+    const auto& columns = lineColumns[row];
+
+    // First grapheme that ends after columnStart.
+    auto begin = std::upper_bound(columns.begin() + 1, columns.end(), columnStart) - (columns.begin() + 1);
+    // First grapheme that starts at or after columnEnd.
+    auto end = std::lower_bound(columns.begin(), columns.end() - 1, columnEnd) - columns.begin();
+
+    if (begin >= end)
+        return {};
+
+    firstColumn = columns[begin];
+    return line.subspan(begin, end - begin);
+}
+
+Point GraphemeBuffer::positionToPoint(Position position) const {
+    if ((position.row < 0) || (position.row >= getNumberOfLines()))
+        return { 0, position.row };
+
+    const auto& columns = lineColumns[position.row];
+    auto column = std::max(0, std::min(position.column, static_cast<int>(columns.size()) - 1));
+    return { columns[column], position.row };
 }
 
 Position GraphemeBuffer::pointToPosition(Point point, bool after) {
@@ -91,31 +124,25 @@ Position GraphemeBuffer::pointToPosition(Point point, bool after) {
     if (point.y >= static_cast<int>(renderedLines.size()))
         point.y = static_cast<int>(renderedLines.size()) - 1;
 
-    auto line = getLine(point.y);
-    
-    int widthSoFar = 0;
-    for (int i = 0; i < line.size(); ++i) {
-        // If this grapheme ends before point, go to next grapheme.
-        if (widthSoFar + line[i].width <= point.x) {
-            widthSoFar += line[i].width;
-            continue;
-        }
+    const auto& columns = lineColumns[point.y];
 
-        // If we are at first cell of a grapheme, return it.
-        if (widthSoFar == point.x) {
-            return Position { point.y, i };
-        }
+    // Find first grapheme that ends after point.
+    auto i = static_cast<int>(std::upper_bound(columns.begin() + 1, columns.end(), point.x) - (columns.begin() + 1));
 
-        // If we are after first cell of a grapheme, and after is true, return next grapheme position.
-        if (after)
-            return Position { point.y, i + 1 };
+    // Return end of line.
+    if (i == static_cast<int>(columns.size()) - 1)
+        return Position { point.y, i };
 
-        // Otherwise simply return current grapheme.
+    // If we are at first cell of a grapheme, return it.
+    if (columns[i] == point.x)
         return Position { point.y, i };
-    }
 
-    // Return end of line.
-    return Position { point.y, static_cast<int>(line.size()) };
+    // If we are after first cell of a grapheme, and after is true, return next grapheme position.
+    if (after)
+        return Position { point.y, i + 1 };
+
+    // Otherwise simply return current grapheme.
+    return Position { point.y, i };
 }
 
 Position GraphemeBuffer::insertText(Position position, const std::string& text) {
@@ -130,6 +157,7 @@ Position GraphemeBuffer::insertText(Position position, const std::string& text)
     ZASSERT(numLinesAdded >= 0);
     // Insert dummy lines. They will be rerendered below.
     renderedLines.insert(renderedLines.begin() + textPosition.row, numLinesAdded, {});
+    lineColumns.insert(lineColumns.begin() + textPosition.row, numLinesAdded, {});
 
     for (int row = textPosition.row; row <= textEndPosition.row; ++row) {
         rerenderLine(row);
@@ -151,6 +179,7 @@ std::string GraphemeBuffer::deleteText(Position startPosition, Position endPosit
     auto numLinesRemoved = getNumberOfLines() - m_textBuffer.getNumberOfLines();
     ZASSERT(numLinesRemoved >= 0);
     renderedLines.erase(renderedLines.begin() + startTextPosition.row, renderedLines.begin() + startTextPosition.row + numLinesRemoved);
+    lineColumns.erase(lineColumns.begin() + startTextPosition.row, lineColumns.begin() + startTextPosition.row + numLinesRemoved);
 
     for (int row = startTextPosition.row; row <= endPosition.row - numLinesRemoved; ++row) {
         rerenderLine(row);
@@ -36,6 +36,7 @@ class GraphemeBuffer {
 private:
     TextBuffer& m_textBuffer;
     std::vector<std::vector<Grapheme>> renderedLines; ///< Will always have at least one line.
+    std::vector<std::vector<int>> lineColumns;        ///< For each line screen columns of all graphemes, followed by width of the line. Lets graphemes be found by screen column in logarithmic time.
 
 public:
     GraphemeBuffer(TextBuffer& textBuffer);
@@ -69,11 +70,21 @@ public:
     /// @param colEnd       One past last grapheme to return (zero indexed).
     gsl::span<const Grapheme> getLineRange(int row, int colStart, int colEnd) const;
 
+    /// Returns part of given line that is visible between screen columns columnStart (inclusive) and columnEnd (exclusive).
+    /// Graphemes that are only partially visible are included.
+    /// Cost doesn't depend on line length, only on number of returned graphemes.
+    /// Span is valid only until next edit on the buffer.
+    /// @param row          Row to return (zero indexed).
+    /// @param columnStart  First visible screen column.
+    /// @param columnEnd    One past last visible screen column.
+    /// @param firstColumn  Set to screen column of the first returned grapheme (or to columnStart if nothing is returned).
+    gsl::span<const Grapheme> getScreenRange(int row, int columnStart, int columnEnd, int& firstColumn) const;
+
     /// Returns Point that corresponds to screen coordinates of given Position.
     /// @param Position     Position of a grapheme (can be one past end of line).
     /// @return Point in screen coordinates of first cell of the grapheme.
     [[nodiscard]]
-    Point positionToPoint(Position position);
+    Point positionToPoint(Position position) const;
 
     /// Returns Position that corresponds to given Point in screen coordinates.
     /// @note If point row is outside of row bounds, it is clamped to valid range.
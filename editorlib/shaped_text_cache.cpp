@@ -0,0 +1,69 @@
+#include "shaped_text_cache.h"
+
+#include "zerrors.h"
+
+namespace terminal_editor {
+
+namespace {
+
+/// Renders given text. Graphemes are made independent of the text.
+std::shared_ptr<const ShapedText> renderText(const std::string& text) {
+    auto shapedText = std::make_shared<ShapedText>();
+    auto codePointInfos = parseLine(text);
+    shapedText->graphemes = renderLine(codePointInfos);
+    for (auto& grapheme : shapedText->graphemes) {
+        grapheme.consumedInput = {};
+    }
+    shapedText->width = getRenderedWidth(shapedText->graphemes);
+    return shapedText;
+}
+
+} // namespace
+
+ShapedTextCache::ShapedTextCache(size_t capacity)
+    : m_capacity(capacity)
+    , m_widthGeneration(textRendererWidthCache.getGeneration()) {
+    ZASSERT(capacity > 0) << "Shaped text cache must have place for at least one text.";
+}
+
+std::shared_ptr<const ShapedText> ShapedTextCache::shape(const std::string& text) {
+    if (text.size() > maxTextSize)
+        return renderText(text);
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+
+    // Generation is read before rendering, so if widths change meanwhile, the text is rendered again next time.
+    auto widthGeneration = textRendererWidthCache.getGeneration();
+    if (widthGeneration != m_widthGeneration) {
+        m_widthGeneration = widthGeneration;
+        m_index.clear();
+        m_entries.clear();
+    }
+
+    auto position = m_index.find(text);
+    if (position != m_index.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, position->second);
+        return position->second->second;
+    }
+
+    auto shapedText = renderText(text);
+    m_entries.emplace_front(text, shapedText);
+    m_index.emplace(text, m_entries.begin());
+    if (m_entries.size() > m_capacity) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    return shapedText;
+}
+
+size_t ShapedTextCache::size() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_entries.size();
+}
+
+std::shared_ptr<const ShapedText> shapeText(const std::string& text) {
+    static ShapedTextCache shapedTextCache(256);
+    return shapedTextCache.shape(text);
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "text_renderer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace terminal_editor {
+
+/// Text rendered into graphemes, together with it's width.
+/// Graphemes don't refer to the text they were rendered from (their consumedInput is empty).
+struct ShapedText {
+    std::vector<Grapheme> graphemes;
+    int width;      ///< Width of all graphemes, in terminal cells.
+};
+
+/// ShapedTextCache keeps recently rendered short texts, like labels, messages and status lines, so text drawn every frame is rendered only once.
+/// Least recently used texts are removed when the cache is full.
+/// Whole cache is cleared when widths in textRendererWidthCache change, since they were used to render the texts.
+/// @note This class is thread safe, because text is also drawn on the render thread.
+class ShapedTextCache {
+public:
+    static constexpr size_t maxTextSize = 256;  ///< Longer texts are rendered, but not cached.
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const ShapedText>>;
+
+    std::mutex m_mutex;
+    size_t m_capacity;                      ///< Maximal number of cached texts.
+    uint64_t m_widthGeneration;             ///< Generation of textRendererWidthCache that cached texts were rendered with.
+    std::list<Entry> m_entries;             ///< Cached texts, most recently used first.
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;    ///< Map from text to it's entry in m_entries.
+
+public:
+    /// @param capacity     Maximal number of cached texts.
+    explicit ShapedTextCache(size_t capacity);
+
+    /// Returns given text rendered into graphemes.
+    /// @param text     UTF-8 string, can be invalid.
+    std::shared_ptr<const ShapedText> shape(const std::string& text);
+
+    /// Returns number of cached texts.
+    size_t size();
+};
+
+/// Returns given text rendered into graphemes, using global ShapedTextCache.
+/// @param text     UTF-8 string, can be invalid.
+std::shared_ptr<const ShapedText> shapeText(const std::string& text);
+
+} // namespace terminal_editor
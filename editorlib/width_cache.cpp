@@ -8,6 +8,7 @@ namespace terminal_editor {
 
 tl::optional<int> CodePointWidthCache::getWidth(uint32_t codePoint)
 {
+    std::unique_lock<std::mutex> lock{mutex};
     auto position = widthCache.find(codePoint);
     if (position == widthCache.end()) {
         missingWidths.insert(codePoint);
@@ -19,21 +20,49 @@ tl::optional<int> CodePointWidthCache::getWidth(uint32_t codePoint)
 
 void CodePointWidthCache::setWidth(uint32_t codePoint, int width)
 {
-    widthCache[codePoint] = width;
+    std::unique_lock<std::mutex> lock{mutex};
+    auto inserted = widthCache.insert({codePoint, width});
+    if (inserted.second || (inserted.first->second != width)) {
+        inserted.first->second = width;
+        ++generation;
+    }
     missingWidths.erase(codePoint);
 }
 
-const std::unordered_set<uint32_t>& CodePointWidthCache::getMissingWidths()
+std::unordered_set<uint32_t> CodePointWidthCache::getMissingWidths()
 {
+    std::unique_lock<std::mutex> lock{mutex};
     return missingWidths;
 }
 
 void CodePointWidthCache::clearWidthCache(bool clearMissingWidths)
 {
+    std::unique_lock<std::mutex> lock{mutex};
     widthCache.clear();
     if (clearMissingWidths) {
         missingWidths.clear();
     }
+    ++generation;
+}
+
+CodePointWidthCache::State CodePointWidthCache::saveState()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    return State{widthCache, missingWidths};
+}
+
+void CodePointWidthCache::restoreState(State state)
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    widthCache = std::move(state.widthCache);
+    missingWidths = std::move(state.missingWidths);
+    ++generation;
+}
+
+uint64_t CodePointWidthCache::getGeneration()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    return generation;
 }
 
 } // namespace terminal_editor
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -15,10 +17,20 @@ namespace terminal_editor {
 /// It also keeps track of all code points for which size was not known.
 /// @note This cache will become invalid if the terminal application (or it's settings) used to render characters will change.
 ///       For this reason a "clear-width-cache" command should be implemented.
+/// @note This class is thread safe, because text is also rendered on the render thread.
 class CodePointWidthCache {
+public:
+    /// Known widths and missing code points. Used to restore the cache after temporary changes.
+    struct State {
+        std::unordered_map<uint32_t, int> widthCache;
+        std::unordered_set<uint32_t> missingWidths;
+    };
+
 private:
+    std::mutex mutex;
     std::unordered_map<uint32_t, int> widthCache;   ///< Map from code point to it's screen width. Combining characters will have width of 0.
     std::unordered_set<uint32_t> missingWidths;     ///< Set of code points which widths were requested, but were not known.
+    uint64_t generation = 0;                        ///< Incremented every time known widths change.
 public:
     /// Returns width of given code point.
     /// If width is not known nullopt is returned and code point is added to missingWidths set.
@@ -28,11 +40,22 @@ public:
     void setWidth(uint32_t codePoint, int width);
 
     /// Get set of code points whose width was requested, but were not known.
-    const std::unordered_set<uint32_t>& getMissingWidths();
+    /// Set is returned by value, because it can be modified by other threads.
+    std::unordered_set<uint32_t> getMissingWidths();
 
     /// Clears the cache.
     /// @param clearMissingWidths   If true missingWidths set is also cleared.
     void clearWidthCache(bool clearMissingWidths);
+
+    /// Returns copy of known widths and missing code points.
+    State saveState();
+
+    /// Replaces known widths and missing code points with ones returned by saveState().
+    void restoreState(State state);
+
+    /// Returns number that changes every time known widths change.
+    /// Text rendered with widths from this cache must be rendered again when it changes.
+    uint64_t getGeneration();
 };
 
 } // namespace terminal_editor
@@ -0,0 +1,39 @@
+#include "catch2/catch.hpp"
+
+#include "action_table.h"
+
+#include <sstream>
+
+using namespace terminal_editor;
+
+TEST_CASE("Action names are interned", "[action-table]") {
+    ActionId left("test-left");
+    ActionId right("test-right");
+
+    REQUIRE(left == ActionId("test-left"));
+    REQUIRE(left != right);
+    REQUIRE(left.getName() == "test-left");
+    REQUIRE(ActionId().getName().empty());
+
+    std::stringstream str;
+    str << right;
+    REQUIRE(str.str() == "test-right");
+}
+
+TEST_CASE("ActionTable dispatches actions to handlers", "[action-table]") {
+    ActionTable<int> table;
+    table.add("test-increment", [](int& value) { ++value; });
+    table.add("test-double", [](int& value) { value *= 2; });
+
+    int value = 1;
+    REQUIRE(table.dispatch(value, ActionId("test-increment")));
+    REQUIRE(table.dispatch(value, ActionId("test-double")));
+    REQUIRE(value == 4);
+
+    // Actions without handlers are not processed.
+    REQUIRE(!table.dispatch(value, ActionId("test-unknown-action")));
+    REQUIRE(!table.dispatch(value, ActionId()));
+    REQUIRE(value == 4);
+
+    REQUIRE_THROWS(table.add("test-double", [](int& value) { value = 0; }));
+}
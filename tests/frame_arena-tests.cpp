@@ -0,0 +1,149 @@
+#include "catch2/catch.hpp"
+
+#include "frame_arena.h"
+#include "window.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace terminal_editor;
+
+namespace {
+
+/// Number of allocations made with global operator new.
+std::atomic<size_t> allocationCount{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    if (auto pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+TEST_CASE("FrameArena reuses memory between frames", "[frame-arena]") {
+    FrameArena arena(256);
+
+    auto fillFrame = [&arena]() {
+        ArenaVector<int> numbers{ArenaAllocator<int>(arena)};
+        for (int i = 0; i < 1000; ++i) {
+            numbers.push_back(i);
+        }
+        auto aligned = arena.allocate(1, 64);
+        REQUIRE(reinterpret_cast<uintptr_t>(aligned) % 64 == 0);
+        REQUIRE(numbers.back() == 999);
+    };
+
+    fillFrame();
+    arena.reset();
+    auto capacity = arena.getCapacity();
+
+    // After reset everything fits in one block, so the same frame doesn't allocate again.
+    auto allocationsBefore = allocationCount.load();
+    fillFrame();
+    auto allocations = allocationCount.load() - allocationsBefore;
+    REQUIRE(allocations == 0);
+    REQUIRE(arena.getCapacity() == capacity);
+}
+
+TEST_CASE("FrameArena destroys objects it made", "[frame-arena]") {
+    FrameArena arena(256);
+    auto counter = std::make_shared<int>(0);
+
+    arena.create<std::shared_ptr<int>>(counter);
+    arena.create<std::shared_ptr<int>>(counter);
+    REQUIRE(counter.use_count() == 3);
+
+    arena.reset();
+    REQUIRE(counter.use_count() == 1);
+
+    {
+        FrameArena otherArena(256);
+        otherArena.create<std::shared_ptr<int>>(counter);
+        REQUIRE(counter.use_count() == 2);
+    }
+    REQUIRE(counter.use_count() == 1);
+}
+
+TEST_CASE("FrameArenaPool lends arenas that no frame uses", "[frame-arena]") {
+    FrameArenaPool pool;
+
+    auto first = pool.acquire();
+    auto second = pool.acquire();
+    REQUIRE(first != second);
+
+    auto counter = std::make_shared<int>(0);
+    first->create<std::shared_ptr<int>>(counter);
+    auto firstPointer = first.get();
+    first = nullptr;
+
+    // Arena dropped by it's frame is reset and lent again.
+    auto third = pool.acquire();
+    REQUIRE(third.get() == firstPointer);
+    REQUIRE(counter.use_count() == 1);
+}
+
+TEST_CASE("Steady-state frames don't allocate memory", "[frame-arena]") {
+    ScreenBuffer screenBuffer;
+    screenBuffer.resize(40, 12);
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+
+    WindowManager windowManager;
+    auto rootWindow = windowManager.getRootWindow();
+    rootWindow->setRect(Rect{Point{0, 0}, Size{40, 12}});
+    // EditorWindow is not used, because it reads editor config from the working directory.
+    auto textWindow = rootWindow->addChild<BasicWindow>("Text", Rect{Point{0, 0}, Size{40, 12}}, true, Attributes{Color::White, Color::Blue, Style::Normal});
+    textWindow->setMessage("Text with \xFF invalid byte.");
+    // Window partially outside of the root window, with replacement graphemes clipped by it's left edge.
+    auto clippedWindow = rootWindow->addChild<BasicWindow>("Clipped", Rect{Point{-3, 2}, Size{14, 5}}, false, Attributes{Color::White, Color::Blue, Style::Normal});
+    messageBox(rootWindow, "Message box covers both windows.");
+
+    // Snapshots are made in their own arena, like snapshots of frames drawn on the render thread.
+    FrameArena snapshotArena;
+    Region dirtyRegion(Rect{Point{0, 0}, Size{40, 12}});
+
+    // Frames alternate between two states, so every frame has changes to present.
+    int frameNumber = 0;
+    bool allFramesPresented = true;
+    auto presentFrame = [&]() {
+        auto odd = (frameNumber++ % 2) != 0;
+        clippedWindow->setMessage(odd ? "\x01\x02\x03 clipped" : "\x01\x02 other");
+        windowManager.setFocusedWindow(odd ? clippedWindow : textWindow);
+        if (frameNumber % 4 == 0) {
+            screenBuffer.setFullRepaintNeeded();
+        }
+
+        snapshotArena.reset();
+        auto rootSnapshot = rootWindow->snapshot(dirtyRegion, snapshotArena);
+        auto canvas = screenBuffer.getCanvas();
+        rootSnapshot->draw(canvas, dirtyRegion);
+        screenBuffer.setCursor(windowManager.getCursorPosition());
+        screenBuffer.present();
+        allFramesPresented = allFramesPresented && !output.str().empty();
+        output.clear();
+    };
+
+    // First frames intern glyphs, shape texts, and grow arenas and buffers.
+    for (int i = 0; i < 8; ++i) {
+        presentFrame();
+    }
+
+    auto allocationsBefore = allocationCount.load();
+    for (int i = 0; i < 8; ++i) {
+        presentFrame();
+    }
+    auto allocations = allocationCount.load() - allocationsBefore;
+    REQUIRE(allocations == 0);
+    REQUIRE(allFramesPresented);
+}
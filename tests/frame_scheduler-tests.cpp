@@ -0,0 +1,72 @@
+#include "catch2/catch.hpp"
+
+#include "frame_scheduler.h"
+
+#include <vector>
+
+using namespace terminal_editor;
+
+TEST_CASE("FrameScheduler paces frames", "[frame-scheduler]") {
+    using namespace std::chrono_literals;
+
+    FrameScheduler frameScheduler(50); // 20ms per frame.
+    auto start = FrameScheduler::Clock::time_point() + 1s;
+
+    REQUIRE(!frameScheduler.isFrameDue(start, false));
+    REQUIRE(frameScheduler.getWaitDeadline(start) == FrameScheduler::Clock::time_point::max());
+
+    SECTION("Frame is drawn right after the last event") {
+        frameScheduler.requestFrame(start);
+        REQUIRE(frameScheduler.isFrameDue(start, false));
+        frameScheduler.frameDrawn(start);
+        REQUIRE(!frameScheduler.isFrameRequested());
+
+        // Frame rate is not limited once there is no more input.
+        frameScheduler.requestFrame(start + 5ms);
+        REQUIRE(frameScheduler.isFrameDue(start + 5ms, false));
+    }
+
+    SECTION("Frames are coalesced while input is pending") {
+        frameScheduler.requestFrame(start);
+        REQUIRE(!frameScheduler.isFrameDue(start, true));
+        REQUIRE(!frameScheduler.isFrameDue(start + 10ms, true));
+        REQUIRE(frameScheduler.getWaitDeadline(start + 10ms) == start + 20ms);
+
+        // Input storm doesn't stop frames.
+        frameScheduler.requestFrame(start + 15ms);
+        REQUIRE(frameScheduler.isFrameDue(start + 20ms, true));
+        frameScheduler.frameDrawn(start + 20ms);
+
+        // At most one frame is drawn per frame interval while input is pending.
+        frameScheduler.requestFrame(start + 20ms);
+        REQUIRE(!frameScheduler.isFrameDue(start + 30ms, true));
+        REQUIRE(frameScheduler.isFrameDue(start + 40ms, true));
+    }
+
+    SECTION("Idle tasks run in round robin") {
+        std::vector<int> steps;
+        frameScheduler.addIdleTask([&steps]() { steps.push_back(1); return steps.size() < 3; });
+        frameScheduler.addIdleTask([&steps]() { steps.push_back(2); return false; });
+        REQUIRE(frameScheduler.hasIdleTasks());
+        REQUIRE(frameScheduler.getWaitDeadline(start) == start);
+
+        auto noInput = []() { return false; };
+        REQUIRE(frameScheduler.runIdleTasks(FrameScheduler::Clock::time_point::max(), noInput) == 3);
+        REQUIRE(steps == std::vector<int>{1, 2, 1});
+        REQUIRE(!frameScheduler.hasIdleTasks());
+        REQUIRE(frameScheduler.runIdleTasks(FrameScheduler::Clock::time_point::max(), noInput) == 0);
+    }
+
+    SECTION("Idle tasks stop at the frame deadline or on input") {
+        int steps = 0;
+        frameScheduler.addIdleTask([&steps]() { ++steps; return true; });
+
+        // Deadline that has passed lets only one step run.
+        REQUIRE(frameScheduler.runIdleTasks(FrameScheduler::Clock::now(), []() { return false; }) == 1);
+
+        int inputChecks = 0;
+        REQUIRE(frameScheduler.runIdleTasks(FrameScheduler::Clock::time_point::max(), [&inputChecks]() { return ++inputChecks == 5; }) == 5);
+        REQUIRE(steps == 6);
+        REQUIRE(frameScheduler.hasIdleTasks());
+    }
+}
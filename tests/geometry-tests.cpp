@@ -0,0 +1,90 @@
+#include "catch2/catch.hpp"
+
+#include "geometry.h"
+
+using namespace terminal_editor;
+
+namespace {
+
+/// Returns number of cells in the region.
+int area(const Region& region) {
+    int cells = 0;
+    for (auto rect : region.rects()) {
+        cells += rect.size.width * rect.size.height;
+    }
+    return cells;
+}
+
+} // namespace
+
+TEST_CASE("Region subtracts rectangles", "[geometry]") {
+    Region region(Rect{Point{0, 0}, Size{10, 5}});
+    REQUIRE(area(region) == 50);
+
+    SECTION("Disjoint rectangle doesn't change the region") {
+        region.subtract(Rect{Point{10, 0}, Size{3, 3}});
+        REQUIRE(region.rects().size() == 1);
+        REQUIRE(area(region) == 50);
+    }
+
+    SECTION("Hole in the middle splits region into four rectangles") {
+        region.subtract(Rect{Point{2, 1}, Size{3, 2}});
+        REQUIRE(region.rects().size() == 4);
+        REQUIRE(area(region) == 44);
+        for (auto rect : region.rects()) {
+            REQUIRE(!rect.overlap(Rect{Point{2, 1}, Size{3, 2}}));
+        }
+    }
+
+    SECTION("Intersection keeps only cells inside the rectangle") {
+        region.subtract(Rect{Point{2, 1}, Size{3, 2}});
+        auto common = region.intersect(Rect{Point{0, 0}, Size{3, 2}});
+        REQUIRE(area(common) == 5);
+        REQUIRE(region.intersect(Rect{Point{2, 1}, Size{3, 2}}).isEmpty());
+    }
+
+    SECTION("Covering rectangles empty the region") {
+        region.subtract(Rect{Point{-1, -1}, Size{6, 10}});
+        REQUIRE(area(region) == 25);
+        region.subtract(Rect{Point{5, 0}, Size{5, 5}});
+        REQUIRE(region.isEmpty());
+    }
+}
+
+TEST_CASE("Region merges added rectangles", "[geometry]") {
+    Region region(Rect{Point{0, 0}, Size{4, 2}});
+
+    SECTION("Contained rectangle doesn't change the region") {
+        region.add(Rect{Point{0, 0}, Size{4, 2}});
+        region.add(Rect{Point{1, 0}, Size{2, 1}});
+        REQUIRE(region.rects().size() == 1);
+        REQUIRE(area(region) == 8);
+    }
+
+    SECTION("Adjacent rectangles are merged") {
+        region.add(Rect{Point{4, 0}, Size{3, 2}});
+        REQUIRE(region.rects().size() == 1);
+        region.add(Rect{Point{0, 2}, Size{7, 1}});
+        REQUIRE(region.rects().size() == 1);
+        REQUIRE(area(region) == 21);
+    }
+
+    SECTION("Overlapping rectangles are merged") {
+        region.add(Rect{Point{2, 0}, Size{4, 2}});
+        REQUIRE(region.rects().size() == 1);
+        REQUIRE(area(region) == 12);
+    }
+
+    SECTION("Adding the same rectangles again doesn't grow the region") {
+        region.add(Rect{Point{2, 1}, Size{4, 4}});
+        auto rectCount = region.rects().size();
+        REQUIRE(area(region) == 8 + 16 - 2);
+
+        for (int i = 0; i < 100; ++i) {
+            region.add(Rect{Point{0, 0}, Size{4, 2}});
+            region.add(Rect{Point{2, 1}, Size{4, 4}});
+        }
+        REQUIRE(region.rects().size() <= rectCount);
+        REQUIRE(area(region) == 8 + 16 - 2);
+    }
+}
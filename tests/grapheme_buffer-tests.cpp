@@ -0,0 +1,57 @@
+#include "catch2/catch.hpp"
+
+#include "grapheme_buffer.h"
+
+using namespace terminal_editor;
+
+TEST_CASE("GraphemeBuffer finds graphemes by screen column", "[grapheme-buffer]") {
+    TextBuffer textBuffer;
+    GraphemeBuffer graphemeBuffer(textBuffer);
+    // Control character is rendered as a replacement wider than one cell.
+    graphemeBuffer.insertText({0, 0}, "ab\x01" "cd\nxyz");
+
+    auto line = graphemeBuffer.getLine(0);
+    REQUIRE(line.size() == 5);
+    auto wideWidth = line[2].width;
+    REQUIRE(wideWidth > 1);
+    REQUIRE(graphemeBuffer.getLongestLineLength() == 4 + wideWidth);
+
+    SECTION("Positions map to points and back") {
+        for (int column = 0; column <= 5; ++column) {
+            auto point = graphemeBuffer.positionToPoint({0, column});
+            REQUIRE(point.x == getRenderedWidth(graphemeBuffer.getLineRange(0, 0, column)));
+            REQUIRE(graphemeBuffer.pointToPosition(point, false) == Position{0, column});
+        }
+        // Point inside a wide grapheme.
+        REQUIRE(graphemeBuffer.pointToPosition({3, 0}, false) == Position{0, 2});
+        REQUIRE(graphemeBuffer.pointToPosition({3, 0}, true) == Position{0, 3});
+        // Point past end of line.
+        REQUIRE(graphemeBuffer.pointToPosition({100, 1}, false) == Position{1, 3});
+    }
+
+    SECTION("Screen range includes partially visible graphemes") {
+        int firstColumn;
+        auto range = graphemeBuffer.getScreenRange(0, 3, 3 + wideWidth, firstColumn);
+        REQUIRE(firstColumn == 2);
+        REQUIRE(range.size() == 2);
+        REQUIRE(range[0].rendered == line[2].rendered);
+        REQUIRE(range[1].rendered == "c");
+
+        range = graphemeBuffer.getScreenRange(0, 0, 1, firstColumn);
+        REQUIRE(firstColumn == 0);
+        REQUIRE(range.size() == 1);
+
+        range = graphemeBuffer.getScreenRange(1, 3, 10, firstColumn);
+        REQUIRE(range.empty());
+        REQUIRE(firstColumn == 3);
+    }
+
+    SECTION("Index follows edits") {
+        graphemeBuffer.insertText({0, 0}, "123\n");
+        REQUIRE(graphemeBuffer.positionToPoint({1, 3}) == Point{2 + wideWidth, 1});
+        graphemeBuffer.deleteText({0, 0}, {1, 2});
+        REQUIRE(graphemeBuffer.getNumberOfLines() == 2);
+        REQUIRE(graphemeBuffer.positionToPoint({0, 2}) == Point{wideWidth + 1, 0});
+        REQUIRE(graphemeBuffer.getLongestLineLength() == wideWidth + 2);
+    }
+}
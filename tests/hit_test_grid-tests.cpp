@@ -0,0 +1,57 @@
+#include "catch2/catch.hpp"
+
+#include "hit_test_grid.h"
+#include "window.h"
+
+using namespace terminal_editor;
+
+TEST_CASE("HitTestGrid finds the topmost rectangle", "[hit-test-grid]") {
+    HitTestGrid grid(Rect{Point{-10, -10}, Size{100, 50}});
+
+    auto background = grid.add(Rect{Point{-10, -10}, Size{100, 50}});
+    auto left = grid.add(Rect{Point{0, 0}, Size{40, 20}});
+    auto overlapping = grid.add(Rect{Point{30, 10}, Size{40, 20}});
+    auto outside = grid.add(Rect{Point{200, 200}, Size{10, 10}});
+
+    REQUIRE(grid.find(Point{-10, -10}) == background);
+    REQUIRE(grid.find(Point{0, 0}) == left);
+    REQUIRE(grid.find(Point{39, 19}) == overlapping);
+    REQUIRE(grid.find(Point{35, 5}) == left);
+    REQUIRE(grid.find(Point{69, 29}) == overlapping);
+    REQUIRE(grid.find(Point{70, 29}) == background);
+    REQUIRE(!grid.find(Point{205, 205}));
+    REQUIRE(!grid.find(Point{-11, 0}));
+    REQUIRE(outside == 3);
+}
+
+TEST_CASE("WindowManager finds windows under points", "[hit-test-grid]") {
+    WindowManager windowManager;
+    auto rootWindow = windowManager.getRootWindow();
+    rootWindow->setRect(Rect{Point{0, 0}, Size{80, 24}});
+
+    Attributes attributes{Color::White, Color::Blue, Style::Normal};
+    auto parent = rootWindow->addChild<BasicWindow>("Parent", Rect{Point{10, 5}, Size{20, 10}}, false, attributes);
+    // Child is added in screen coordinates, and is clipped by it's parent.
+    auto child = parent->addChild<BasicWindow>("Child", Rect{Point{25, 10}, Size{20, 10}}, false, attributes);
+    auto top = rootWindow->addChild<BasicWindow>("Top", Rect{Point{12, 6}, Size{5, 3}}, false, attributes);
+
+    REQUIRE(child->getScreenRect().topLeft == Point{25, 10});
+    REQUIRE(windowManager.getWindowForPoint(Point{0, 0}) == rootWindow);
+    REQUIRE(windowManager.getWindowForPoint(Point{11, 5}) == parent);
+    REQUIRE(windowManager.getWindowForPoint(Point{26, 11}) == child);
+    REQUIRE(windowManager.getWindowForPoint(Point{35, 11}) == rootWindow);
+    REQUIRE(windowManager.getWindowForPoint(Point{12, 6}) == top);
+    REQUIRE(!windowManager.getWindowForPoint(Point{80, 0}));
+
+    SECTION("Moving parent moves children") {
+        parent->moveBy(Size{-10, -5});
+        REQUIRE(child->getScreenRect().topLeft == Point{15, 5});
+        REQUIRE(windowManager.getWindowForPoint(Point{18, 9}) == child);
+        REQUIRE(windowManager.getWindowForPoint(Point{26, 11}) == rootWindow);
+    }
+
+    SECTION("Closed windows are not found") {
+        top->close();
+        REQUIRE(windowManager.getWindowForPoint(Point{12, 6}) == parent);
+    }
+}
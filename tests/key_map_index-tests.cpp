@@ -0,0 +1,92 @@
+#include "catch2/catch.hpp"
+
+#include "editor_config.h"
+
+using namespace terminal_editor;
+
+namespace {
+
+KeyMap::KeyBinding makeBinding(const std::string& action) {
+    KeyMap::KeyBinding binding{};
+    binding.action = ActionId(action);
+    return binding;
+}
+
+} // namespace
+
+TEST_CASE("KeyMapIndex finds actions bound to inputs", "[key-map-index]") {
+    std::map<std::string, KeyMap> keyMaps;
+
+    auto& global = keyMaps["global"];
+    global.name = "global";
+    auto binding = makeBinding("test-quit");
+    binding.key = "Q";
+    binding.ctrl = true;
+    global.bindings.push_back(binding);
+    binding = makeBinding("test-global-a");
+    binding.key = "a";
+    global.bindings.push_back(binding);
+    binding = makeBinding("test-wheel-up");
+    binding.mouseAction = KeyMap::MouseAction::WheelUp;
+    global.bindings.push_back(binding);
+    binding = makeBinding("test-ctrl-right");
+    binding.csi = KeyMap::CsiSequence{{1, 5}, 'C'};
+    global.bindings.push_back(binding);
+    binding = makeBinding("test-f1");
+    binding.ss3 = "P";
+    global.bindings.push_back(binding);
+
+    auto& editor = keyMaps["editor"];
+    editor.name = "editor";
+    editor.parent = "global";
+    binding = makeBinding("test-editor-a");
+    binding.key = "a";
+    editor.bindings.push_back(binding);
+    binding = makeBinding("test-first");
+    binding.key = "b";
+    editor.bindings.push_back(binding);
+    binding = makeBinding("test-second");
+    binding.onAction = ActionId("test-first");
+    editor.bindings.push_back(binding);
+    binding = makeBinding("test-ping");
+    binding.key = "p";
+    editor.bindings.push_back(binding);
+    binding = makeBinding("test-pong");
+    binding.onAction = ActionId("test-ping");
+    editor.bindings.push_back(binding);
+    binding = makeBinding("test-ping");
+    binding.onAction = ActionId("test-pong");
+    editor.bindings.push_back(binding);
+
+    KeyMapIndex index(keyMaps);
+
+    SECTION("Keys") {
+        REQUIRE(index.findKeyAction("global", 'a', tl::nullopt) == ActionId("test-global-a"));
+        REQUIRE(index.findKeyAction("editor", 'a', tl::nullopt) == ActionId("test-editor-a"));
+        REQUIRE(index.findKeyAction("editor", 'Q', tl::nullopt) == tl::nullopt);
+        REQUIRE(index.findKeyAction("editor", 0x11, uint32_t('Q')) == ActionId("test-quit"));
+    }
+
+    SECTION("Escape sequences and mouse") {
+        REQUIRE(index.findMouseAction("editor", KeyMap::MouseAction::WheelUp) == ActionId("test-wheel-up"));
+        REQUIRE(index.findMouseAction("editor", KeyMap::MouseAction::WheelDown) == tl::nullopt);
+        REQUIRE(index.findCsiAction("editor", 'C', std::vector<int>{1, 5}) == ActionId("test-ctrl-right"));
+        REQUIRE(index.findCsiAction("editor", 'C', std::vector<int>{}) == tl::nullopt);
+        REQUIRE(index.findSsAction("editor", true, "P") == ActionId("test-f1"));
+        REQUIRE(index.findSsAction("editor", false, "P") == tl::nullopt);
+    }
+
+    SECTION("Unknown context falls back to global") {
+        REQUIRE(index.findKeyAction("unknown", 'a', tl::nullopt) == ActionId("test-global-a"));
+    }
+
+    SECTION("Actions are translated") {
+        REQUIRE(index.findKeyAction("editor", 'b', tl::nullopt) == ActionId("test-second"));
+        REQUIRE_THROWS_WITH(index.findKeyAction("editor", 'p', tl::nullopt), Catch::Contains("Circular action chain"));
+    }
+
+    SECTION("Missing parent is reported") {
+        keyMaps["editor"].parent = "missing";
+        REQUIRE_THROWS(KeyMapIndex(keyMaps));
+    }
+}
@@ -0,0 +1,160 @@
+#include "catch2/catch.hpp"
+
+#include "key_sequence_matcher.h"
+
+using namespace terminal_editor;
+
+namespace {
+
+KeyMap::KeyBinding makeSequenceBinding(std::vector<KeyMap::KeyStroke> sequence, const std::string& action) {
+    KeyMap::KeyBinding binding{};
+    binding.sequence = std::move(sequence);
+    binding.action = ActionId(action);
+    return binding;
+}
+
+/// Returns event of a key pressed with ctrl.
+KeyPressed ctrlKey(char key) {
+    return KeyPressed{static_cast<uint32_t>(key & 0x1F)};
+}
+
+} // namespace
+
+TEST_CASE("KeySequenceMatcher resolves key sequences", "[key-sequence-matcher]") {
+    std::map<std::string, KeyMap> keyMaps;
+    auto& global = keyMaps["global"];
+    global.name = "global";
+    global.bindings.push_back(makeSequenceBinding({{"X", true}, {"S", true}}, "test-save"));
+    global.bindings.push_back(makeSequenceBinding({{"X", true}, {"k", false}}, "test-kill"));
+    global.bindings.push_back(makeSequenceBinding({{"X", true}, {"r", false}, {"t", false}}, "test-rectangle"));
+    global.bindings.push_back(makeSequenceBinding({{"g", false}, {"g", false}}, "test-first-line"));
+    KeyMap::KeyBinding keyBinding{};
+    keyBinding.key = "g";
+    keyBinding.action = ActionId("test-go");
+    global.bindings.push_back(keyBinding);
+
+    KeyMapIndex keyMapIndex(keyMaps);
+    KeySequenceMatcher matcher(std::chrono::seconds(1));
+    auto now = KeySequenceMatcher::Clock::now();
+
+    SECTION("Sequence is completed key by key") {
+        auto result = matcher.processEvent("global", ctrlKey('X'), keyMapIndex, now);
+        REQUIRE(result.consumed);
+        REQUIRE(!result.action);
+        REQUIRE(matcher.isPending());
+        REQUIRE(matcher.getPendingKeys() == "Ctrl-X");
+
+        result = matcher.processEvent("global", ctrlKey('S'), keyMapIndex, now);
+        REQUIRE(result.consumed);
+        REQUIRE(result.action == ActionId("test-save"));
+        REQUIRE(!matcher.isPending());
+        REQUIRE(matcher.getPendingKeys().empty());
+
+        matcher.processEvent("global", ctrlKey('X'), keyMapIndex, now);
+        matcher.processEvent("global", KeyPressed{'r'}, keyMapIndex, now);
+        REQUIRE(matcher.getPendingKeys() == "Ctrl-X r");
+        result = matcher.processEvent("global", KeyPressed{'t'}, keyMapIndex, now);
+        REQUIRE(result.action == ActionId("test-rectangle"));
+    }
+
+    SECTION("Keys that are not in sequences are not consumed") {
+        auto result = matcher.processEvent("global", KeyPressed{'a'}, keyMapIndex, now);
+        REQUIRE(!result.consumed);
+        REQUIRE(!result.abandonedAction);
+        REQUIRE(!matcher.isPending());
+    }
+
+    SECTION("Key that doesn't continue a sequence abandons it") {
+        matcher.processEvent("global", ctrlKey('X'), keyMapIndex, now);
+        auto result = matcher.processEvent("global", KeyPressed{'a'}, keyMapIndex, now);
+        REQUIRE(!result.consumed);
+        REQUIRE(!result.abandonedAction);
+        REQUIRE(!matcher.isPending());
+
+        // Keys without an action are returned to be processed normally.
+        REQUIRE(result.abandonedKeys.size() == 1);
+        REQUIRE(result.abandonedKeys[0].codePoint == 0x18);
+
+        // Abandoned ambiguous prefix performs it's own action, and the key can start another sequence.
+        matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+        result = matcher.processEvent("global", ctrlKey('X'), keyMapIndex, now);
+        REQUIRE(result.consumed);
+        REQUIRE(result.abandonedAction == ActionId("test-go"));
+        REQUIRE(result.abandonedKeys.empty());
+        REQUIRE(matcher.getPendingKeys() == "Ctrl-X");
+
+        // All keys of a longer prefix are returned.
+        matcher.processEvent("global", KeyPressed{'r'}, keyMapIndex, now);
+        result = matcher.processEvent("global", KeyPressed{'a'}, keyMapIndex, now);
+        REQUIRE(!result.abandonedAction);
+        REQUIRE(result.abandonedKeys.size() == 2);
+        REQUIRE(result.abandonedKeys[0].codePoint == 0x18);
+        REQUIRE(result.abandonedKeys[1].codePoint == 'r');
+    }
+
+    SECTION("Ambiguous prefix is resolved after timeout") {
+        auto result = matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+        REQUIRE(result.consumed);
+        REQUIRE(matcher.getDeadline() == now + std::chrono::seconds(1));
+
+        REQUIRE(!matcher.checkTimeout(now + std::chrono::milliseconds(500)).abandonedAction);
+        REQUIRE(matcher.isPending());
+        result = matcher.checkTimeout(now + std::chrono::seconds(1));
+        REQUIRE(result.abandonedAction == ActionId("test-go"));
+        REQUIRE(result.abandonedKeys.empty());
+        REQUIRE(!matcher.isPending());
+
+        matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+        result = matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+        REQUIRE(result.action == ActionId("test-first-line"));
+    }
+
+    SECTION("Other events abandon a sequence") {
+        matcher.processEvent("global", ctrlKey('X'), keyMapIndex, now);
+        auto result = matcher.processEvent("global", MouseEvent{MouseEvent::Kind::LMB, Point{0, 0}}, keyMapIndex, now);
+        REQUIRE(!result.consumed);
+        REQUIRE(!matcher.isPending());
+    }
+}
+
+TEST_CASE("KeySequenceMatcher returns keys of abandoned sequences without an action", "[key-sequence-matcher]") {
+    std::map<std::string, KeyMap> keyMaps;
+    auto& global = keyMaps["global"];
+    global.name = "global";
+    global.bindings.push_back(makeSequenceBinding({{"g", false}, {"g", false}}, "test-first-line"));
+
+    KeyMapIndex keyMapIndex(keyMaps);
+    KeySequenceMatcher matcher(std::chrono::seconds(1));
+    auto now = KeySequenceMatcher::Clock::now();
+
+    // Unbound key that starts a sequence is consumed.
+    auto result = matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+    REQUIRE(result.consumed);
+    REQUIRE(matcher.isPending());
+
+    SECTION("Key that doesn't continue the sequence") {
+        result = matcher.processEvent("global", KeyPressed{'a'}, keyMapIndex, now);
+        REQUIRE(!result.consumed);
+        REQUIRE(!result.abandonedAction);
+        REQUIRE(result.abandonedKeys.size() == 1);
+        REQUIRE(result.abandonedKeys[0].codePoint == 'g');
+    }
+
+    SECTION("Timeout") {
+        result = matcher.checkTimeout(now + std::chrono::seconds(1));
+        REQUIRE(!result.consumed);
+        REQUIRE(!result.abandonedAction);
+        REQUIRE(result.abandonedKeys.size() == 1);
+        REQUIRE(result.abandonedKeys[0].codePoint == 'g');
+        REQUIRE(!matcher.isPending());
+    }
+
+    SECTION("Completed sequence returns no keys") {
+        result = matcher.processEvent("global", KeyPressed{'g'}, keyMapIndex, now);
+        REQUIRE(result.action == ActionId("test-first-line"));
+        REQUIRE(result.abandonedKeys.empty());
+
+        result = matcher.checkTimeout(now + std::chrono::seconds(1));
+        REQUIRE(result.abandonedKeys.empty());
+    }
+}
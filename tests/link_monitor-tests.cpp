@@ -0,0 +1,41 @@
+#include "catch2/catch.hpp"
+
+#include "link_monitor.h"
+
+using namespace terminal_editor;
+using namespace std::chrono_literals;
+
+TEST_CASE("LinkMonitor detects saturated link", "[link-monitor]") {
+    LinkMonitor linkMonitor;
+    REQUIRE(!linkMonitor.isSaturated());
+    REQUIRE(linkMonitor.getThroughput() == 0.0);
+
+    SECTION("Fast writes don't measure throughput") {
+        for (int i = 0; i < 10; ++i) {
+            linkMonitor.frameWritten(100000, 100us);
+        }
+        REQUIRE(!linkMonitor.isSaturated());
+        REQUIRE(linkMonitor.getThroughput() == 0.0);
+    }
+
+    SECTION("Slow writes saturate the link, until writes are fast again") {
+        // 7000 bytes per second, like a 56 kbit/s modem.
+        for (int i = 0; i < 10; ++i) {
+            linkMonitor.frameWritten(700, 100ms);
+        }
+        REQUIRE(linkMonitor.isSaturated());
+        REQUIRE(linkMonitor.getThroughput() == Approx(7000.0));
+
+        // Small frames that still block a bit don't end saturation.
+        for (int i = 0; i < 10; ++i) {
+            linkMonitor.frameWritten(100, 15ms);
+        }
+        REQUIRE(linkMonitor.isSaturated());
+
+        for (int i = 0; i < 10; ++i) {
+            linkMonitor.frameWritten(100, 100us);
+        }
+        REQUIRE(!linkMonitor.isSaturated());
+        REQUIRE(linkMonitor.getThroughput() > 0.0);
+    }
+}
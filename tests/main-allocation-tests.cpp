@@ -0,0 +1,10 @@
+#define CATCH_CONFIG_RUNNER // We will provide our own main().
+#include "catch2/catch.hpp"
+
+#include <clocale>
+
+// Tests in this executable count allocations of the whole process, so they are kept apart from other tests.
+int main(int argc, char* argv[]) {
+    std::setlocale(LC_ALL, "en_US.UTF8"); // @note This is a hack to make sure wcwidth() understands unicode characters.
+    return Catch::Session().run(argc, argv);
+}
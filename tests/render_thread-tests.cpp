@@ -0,0 +1,66 @@
+#include "catch2/catch.hpp"
+
+#include "render_thread.h"
+#include "zerrors.h"
+
+#include <future>
+#include <vector>
+
+using namespace terminal_editor;
+
+TEST_CASE("RenderThread renders the latest frame", "[render-thread]") {
+    // Empty screen buffer never writes to the terminal.
+    ScreenBuffer screenBuffer;
+    RenderThread renderThread(screenBuffer);
+
+    std::vector<int> rendered;
+
+    SECTION("Frames waiting to be rendered are replaced") {
+        std::promise<void> started;
+        std::promise<void> release;
+        auto released = release.get_future().share();
+
+        renderThread.submitFrame([&rendered, &started, released](ScreenBuffer&) {
+            started.set_value();
+            released.wait();
+            rendered.push_back(1);
+        });
+        started.get_future().wait();
+
+        // First frame is being rendered, so these wait, and only the last one is kept.
+        renderThread.submitFrame([&rendered](ScreenBuffer&) { rendered.push_back(2); });
+        renderThread.submitFrame([&rendered](ScreenBuffer&) { rendered.push_back(3); });
+        release.set_value();
+
+        renderThread.waitUntilIdle();
+        REQUIRE(rendered == std::vector<int>{1, 3});
+    }
+
+    SECTION("Frame waiting to be rendered can be reclaimed") {
+        std::promise<void> started;
+        std::promise<void> release;
+        auto released = release.get_future().share();
+
+        renderThread.submitFrame([&rendered, &started, released](ScreenBuffer&) {
+            started.set_value();
+            released.wait();
+            rendered.push_back(1);
+        });
+        started.get_future().wait();
+
+        // Frame that is being rendered can't be reclaimed.
+        REQUIRE(!renderThread.reclaimPendingFrame());
+        renderThread.submitFrame([&rendered](ScreenBuffer&) { rendered.push_back(2); });
+        REQUIRE(renderThread.reclaimPendingFrame());
+        release.set_value();
+
+        renderThread.waitUntilIdle();
+        REQUIRE(rendered == std::vector<int>{1});
+    }
+
+    SECTION("Errors are passed to the model thread") {
+        renderThread.submitFrame([](ScreenBuffer&) { ZTHROW() << "Frame failed."; });
+        REQUIRE_THROWS_WITH(renderThread.waitUntilIdle(), Catch::Contains("Frame failed."));
+        REQUIRE_THROWS(renderThread.submitFrame([](ScreenBuffer&) {}));
+    }
+}
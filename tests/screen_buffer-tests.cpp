@@ -0,0 +1,480 @@
+#include "catch2/catch.hpp"
+
+#include "screen_buffer.h"
+#include "worker_pool.h"
+
+#include <tuple>
+
+using namespace terminal_editor;
+
+namespace {
+
+/// Minimal terminal that interprets escape sequences written by TerminalEncoder.
+/// Used to check that different outputs draw the same screen. Only single byte characters are supported.
+class TestTerminal {
+public:
+    struct Cell {
+        char text = ' ';
+        std::string fgColor;    ///< SGR parameters of foreground color, empty for the default color.
+        std::string bgColor;    ///< SGR parameters of background color, empty for the default color.
+        int style = 0;          ///< SGR parameters of style flags that are on, as bits.
+
+        bool operator==(const Cell& other) const {
+            return std::tie(text, fgColor, bgColor, style) == std::tie(other.text, other.fgColor, other.bgColor, other.style);
+        }
+    };
+
+private:
+    Size m_size;
+    std::vector<Cell> m_cells;
+    Cell m_pen;             ///< Attributes of printed characters.
+    char m_lastPrinted = ' ';
+    int m_x = 0;
+    int m_y = 0;
+    int m_top = 0;
+    int m_bottom;
+
+public:
+    explicit TestTerminal(Size size)
+        : m_size(size)
+        , m_cells(static_cast<size_t>(size.width * size.height))
+        , m_bottom(size.height - 1) {
+    }
+
+    const std::vector<Cell>& cells() const {
+        return m_cells;
+    }
+
+    void write(const std::string& output) {
+        for (size_t i = 0; i < output.size(); ++i) {
+            auto c = output[i];
+            if (c == '\x1B') {
+                if (output[i + 1] == 'M') {
+                    reverseIndex();
+                    ++i;
+                    continue;
+                }
+                REQUIRE(output[i + 1] == '[');
+                auto end = output.find_first_of("@ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz", i + 2);
+                REQUIRE(end != std::string::npos);
+                csi(output.substr(i + 2, end - i - 2), output[end]);
+                i = end;
+            } else if (c == '\n') {
+                lineFeed();
+            } else if (c == '\r') {
+                m_x = 0;
+            } else if (c == '\b') {
+                m_x = std::max(0, std::min(m_x, m_size.width - 1) - 1);
+            } else {
+                print(c);
+            }
+        }
+    }
+
+private:
+    Cell& cell(int x, int y) {
+        return m_cells[static_cast<size_t>(y * m_size.width + x)];
+    }
+
+    void print(char c) {
+        if (m_x >= m_size.width) {
+            m_x = 0;
+            lineFeed();
+        }
+        m_pen.text = c;
+        cell(m_x, m_y) = m_pen;
+        m_lastPrinted = c;
+        ++m_x;
+    }
+
+    /// Erased cells get only the current background color.
+    Cell blank() const {
+        Cell erased;
+        erased.bgColor = m_pen.bgColor;
+        return erased;
+    }
+
+    void lineFeed() {
+        if (m_y == m_bottom) {
+            scroll(1);
+        } else {
+            m_y = std::min(m_y + 1, m_size.height - 1);
+        }
+    }
+
+    void reverseIndex() {
+        if (m_y == m_top) {
+            scroll(-1);
+        } else {
+            m_y = std::max(m_y - 1, 0);
+        }
+    }
+
+    /// Scrolls the scroll region up by given number of rows, or down if count is negative.
+    void scroll(int count) {
+        for (int i = 0; i < std::abs(count); ++i) {
+            for (int row = 0; row < m_bottom - m_top; ++row) {
+                auto to = (count > 0) ? m_top + row : m_bottom - row;
+                auto from = (count > 0) ? to + 1 : to - 1;
+                std::copy_n(&cell(0, from), m_size.width, &cell(0, to));
+            }
+            auto exposed = (count > 0) ? m_bottom : m_top;
+            std::fill_n(&cell(0, exposed), m_size.width, blank());
+        }
+    }
+
+    void csi(const std::string& parameters, char finalByte) {
+        if (!parameters.empty() && (parameters[0] == '?'))
+            return;
+
+        std::vector<int> params;
+        std::string param;
+        for (auto c : parameters + ";") {
+            if (c == ';') {
+                params.push_back(param.empty() ? 0 : std::stoi(param));
+                param.clear();
+            } else {
+                param += c;
+            }
+        }
+        auto get = [&params](size_t index, int defaultValue) {
+            return ((index < params.size()) && (params[index] != 0)) ? params[index] : defaultValue;
+        };
+
+        switch (finalByte) {
+            case 'H': m_y = get(0, 1) - 1; m_x = get(1, 1) - 1; break;
+            case 'A': m_y = std::max(m_y - get(0, 1), 0); break;
+            case 'B': m_y = std::min(m_y + get(0, 1), m_size.height - 1); break;
+            case 'C': m_x = std::min(m_x + get(0, 1), m_size.width - 1); break;
+            case 'D': m_x = std::max(std::min(m_x, m_size.width - 1) - get(0, 1), 0); break;
+            case 'd': m_y = get(0, 1) - 1; break;
+            case 'G': m_x = get(0, 1) - 1; break;
+            case 'b':
+                for (int i = 0; i < get(0, 1); ++i) {
+                    print(m_lastPrinted);
+                }
+                break;
+            case 'X':
+                for (int i = m_x; i < std::min(m_x + get(0, 1), m_size.width); ++i) {
+                    cell(i, m_y) = blank();
+                }
+                break;
+            case 'K':
+                for (int i = std::min(m_x, m_size.width - 1); i < m_size.width; ++i) {
+                    cell(i, m_y) = blank();
+                }
+                break;
+            case 'r': m_top = get(0, 1) - 1; m_bottom = get(1, m_size.height) - 1; m_x = 0; m_y = 0; break;
+            case 'S': scroll(get(0, 1)); break;
+            case 'T': scroll(-get(0, 1)); break;
+            case 'm': setAttributes(params); break;
+            default: FAIL("Unexpected escape sequence: " << parameters << finalByte);
+        }
+    }
+
+    void setAttributes(const std::vector<int>& params) {
+        for (size_t i = 0; i < params.size(); ++i) {
+            auto param = params[i];
+            if (param == 0) {
+                m_pen = Cell();
+            } else if ((param == 1) || (param == 3) || (param == 4) || (param == 7)) {
+                m_pen.style |= 1 << param;
+            } else if ((param == 22) || (param == 23) || (param == 24) || (param == 27)) {
+                m_pen.style &= ~(1 << ((param == 22) ? 1 : param - 20));
+            } else if ((param == 38) || (param == 48)) {
+                auto length = (params[i + 1] == 5) ? 2u : 4u;
+                std::string color;
+                for (size_t j = i + 1; j <= i + length; ++j) {
+                    color += std::to_string(params[j]) + ";";
+                }
+                ((param == 38) ? m_pen.fgColor : m_pen.bgColor) = color;
+                i += length;
+            } else if ((param == 39) || (param == 49)) {
+                ((param == 39) ? m_pen.fgColor : m_pen.bgColor).clear();
+            } else if (((param >= 30) && (param <= 37)) || ((param >= 90) && (param <= 97))) {
+                m_pen.fgColor = std::to_string(param);
+            } else {
+                REQUIRE((((param >= 40) && (param <= 47)) || ((param >= 100) && (param <= 107))));
+                m_pen.bgColor = std::to_string(param - 10);
+            }
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE("ScreenBuffer draws only changed cells", "[screen-buffer]") {
+    ScreenBuffer screenBuffer;
+    screenBuffer.setTerminalCapabilities(TerminalCapabilities());
+    screenBuffer.resize(10, 4);
+
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+    screenBuffer.present();
+    output.clear();
+
+    Attributes attributes{Color::White, Color::Blue, Style::Normal};
+    screenBuffer.print(2, 1, "ab", attributes);
+
+    SECTION("Only damaged cells are drawn") {
+        screenBuffer.present();
+        REQUIRE(output.str() == "\x1B[2;3H\x1B[0;37;44mab");
+        output.clear();
+
+        // Damage is cleared by present().
+        screenBuffer.present();
+        REQUIRE(output.str() == "");
+    }
+
+    SECTION("Rows drawn with the same contents are skipped") {
+        screenBuffer.present();
+        output.clear();
+
+        screenBuffer.print(2, 1, "ab", attributes);
+        screenBuffer.present();
+        REQUIRE(output.str() == "");
+
+        // Changes overwritten before present() are not drawn.
+        screenBuffer.print(2, 1, "xy", attributes);
+        screenBuffer.print(2, 1, "ab", attributes);
+        screenBuffer.present();
+        REQUIRE(output.str() == "");
+    }
+}
+
+TEST_CASE("ScreenBuffer scrolls moved rows", "[screen-buffer]") {
+    TerminalCapabilities capabilities;
+    capabilities.scrollRegion = true;
+    capabilities.scrollUpDown = true;
+
+    ScreenBuffer screenBuffer;
+    screenBuffer.setTerminalCapabilities(capabilities);
+    screenBuffer.resize(10, 5);
+
+    Attributes attributes{Color::White, Color::Blue, Style::Normal};
+    screenBuffer.print(0, 0, "header", attributes);
+    for (int y = 1; y < 5; ++y) {
+        screenBuffer.print(0, y, "row " + std::to_string(y), attributes);
+    }
+
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+    screenBuffer.present();
+    output.clear();
+
+    SECTION("Rows moved up are scrolled with SU") {
+        for (int y = 1; y < 4; ++y) {
+            screenBuffer.print(0, y, "row " + std::to_string(y + 1), attributes);
+        }
+        screenBuffer.print(0, 4, "row 5", attributes);
+        screenBuffer.present();
+
+        // Region of moved rows is scrolled, and only the exposed row at the bottom is repainted.
+        auto scroll = std::string("\x1B[2;5r\x1B[S\x1B[r");
+        REQUIRE(output.str().substr(0, scroll.size()) == scroll);
+        auto repaint = output.str().substr(scroll.size());
+        REQUIRE(repaint.find("\x1B[5H") == 0);
+        REQUIRE(repaint.find("row 5") != std::string::npos);
+        REQUIRE(repaint.find("row 4") == std::string::npos);
+        REQUIRE(repaint.find("header") == std::string::npos);
+    }
+
+    SECTION("Rows moved down are scrolled with SD") {
+        for (int y = 2; y < 5; ++y) {
+            screenBuffer.print(0, y, "row " + std::to_string(y - 1), attributes);
+        }
+        screenBuffer.print(0, 1, "row 0", attributes);
+        screenBuffer.present();
+
+        // Region of moved rows is scrolled, and only the exposed row at the top is repainted.
+        auto scroll = std::string("\x1B[2;5r\x1B[T\x1B[r");
+        REQUIRE(output.str().substr(0, scroll.size()) == scroll);
+        auto repaint = output.str().substr(scroll.size());
+        REQUIRE(repaint.find("\x1B[2H") == 0);
+        REQUIRE(repaint.find("row 0") != std::string::npos);
+        REQUIRE(repaint.find("row 1") == std::string::npos);
+        REQUIRE(repaint.find("header") == std::string::npos);
+    }
+}
+
+TEST_CASE("ScreenBuffer erases only blank runs", "[screen-buffer]") {
+    TerminalCapabilities capabilities;
+    capabilities.backColorErase = true;
+    capabilities.eraseCharacters = true;
+
+    ScreenBuffer screenBuffer;
+    screenBuffer.setTerminalCapabilities(capabilities);
+    screenBuffer.resize(20, 2);
+
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+    screenBuffer.present();
+    output.clear();
+
+    auto spaces = std::string(12, ' ');
+
+    SECTION("Blank run is erased") {
+        screenBuffer.print(0, 1, spaces, Attributes{Color::White, Color::Blue, Style::Normal});
+        screenBuffer.present();
+        REQUIRE(output.str().find("\x1B[12X") != std::string::npos);
+        REQUIRE(output.str().find(spaces) == std::string::npos);
+    }
+
+    SECTION("Underlined spaces are printed") {
+        screenBuffer.print(0, 1, spaces, Attributes{Color::White, Color::Blue, Style::Underline});
+        screenBuffer.present();
+        REQUIRE(output.str().find("\x1B[12X") == std::string::npos);
+        REQUIRE(output.str().find(spaces) != std::string::npos);
+    }
+
+    SECTION("Reversed spaces are printed") {
+        screenBuffer.print(0, 1, std::string(20, ' '), Attributes{Color::White, Color::Blue, Style::Reverse});
+        screenBuffer.present();
+        REQUIRE(output.str().find("\x1B[K") == std::string::npos);
+        REQUIRE(output.str().find(std::string(20, ' ')) != std::string::npos);
+    }
+}
+
+TEST_CASE("ScreenBuffer fills cells left by overwritten wide graphemes", "[screen-buffer]") {
+    ScreenBuffer screenBuffer;
+    screenBuffer.setTerminalCapabilities(TerminalCapabilities());
+    screenBuffer.resize(10, 2);
+
+    Attributes attributes{Color::White, Color::Blue, Style::Normal};
+    std::vector<Grapheme> graphemes{Grapheme{GraphemeKind::REPLACEMENT, "[x66]", "", 5, {}}};
+    screenBuffer.print(2, 1, graphemes, attributes);
+
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+    screenBuffer.present();
+    output.clear();
+
+    // Run covers only the start of the wide grapheme, so the rest of it is filled with vacuum characters.
+    screenBuffer.fillRun(0, 1, 4, Grapheme{GraphemeKind::NORMAL, "-", "", 1, {}}, attributes);
+    screenBuffer.present();
+    REQUIRE(output.str() == "\x1B[2H\x1B[0;37;44m----\x1B[36;43m   ");
+}
+
+TEST_CASE("ScreenBuffer removes glyphs that are no longer on the screen", "[screen-buffer]") {
+    ScreenBuffer screenBuffer;
+    screenBuffer.setTerminalCapabilities(TerminalCapabilities());
+    screenBuffer.resize(10, 2);
+
+    OutputBuffer output;
+    screenBuffer.setOutputCapture(&output);
+
+    Attributes attributes{Color::White, Color::Blue, Style::Normal};
+    auto replacement = [](const std::string& text) {
+        return std::vector<Grapheme>{Grapheme{GraphemeKind::REPLACEMENT, text, "", static_cast<int>(text.size()), {}}};
+    };
+
+    // Long glyph texts are kept in the glyph table.
+    screenBuffer.print(0, 1, replacement("[keep]"), attributes);
+    for (int i = 0; i < 10 * ScreenBuffer::minGlyphCompactionSize; ++i) {
+        screenBuffer.print(0, 0, replacement("[" + std::to_string(i) + "]"), attributes);
+        screenBuffer.present();
+    }
+    REQUIRE(screenBuffer.getGlyphCount() <= ScreenBuffer::minGlyphCompactionSize);
+
+    // Glyphs that are still on the screen are drawn with their texts.
+    output.clear();
+    screenBuffer.setFullRepaintNeeded();
+    screenBuffer.present();
+    REQUIRE(output.str().find("[keep]") != std::string::npos);
+    REQUIRE(output.str().find("[" + std::to_string(10 * ScreenBuffer::minGlyphCompactionSize - 1) + "]") != std::string::npos);
+}
+
+namespace {
+
+/// Draws row of the band repaint test, showing given logical row.
+/// Rows have different text and background attributes, so each band starts with different SGR state.
+void drawTestRow(ScreenBuffer& screenBuffer, int y, int row) {
+    const Color colors[] = {Color::Red, Color::Green, Color::Yellow, Color::Blue, Color::Magenta, Color::Cyan, indexedColor(200), rgbColor(10, 20, 30)};
+    const Style styles[] = {Style::Normal, Style::Bold, Style::Underline | Style::Italic, Style::Reverse};
+    Attributes textAttributes{colors[row % 8], Color::Black, styles[row % 4]};
+    Attributes blankAttributes{Color::White, colors[(row + 3) % 8], Style::Normal};
+
+    auto width = screenBuffer.getSize().width;
+    auto text = "row " + std::to_string(row);
+    text.resize(10, '.');
+    screenBuffer.print(0, y, text, textAttributes);
+    screenBuffer.print(10, y, std::string(static_cast<size_t>(width - 40), ' '), blankAttributes);
+    screenBuffer.print(width - 30, y, std::string(20, (row % 2) ? '=' : '-'), textAttributes);
+    screenBuffer.print(width - 10, y, std::string(10, ' '), (row % 3) ? blankAttributes : textAttributes);
+}
+
+} // namespace
+
+TEST_CASE("ScreenBuffer repaints the same screen in bands", "[screen-buffer]") {
+    auto threadCount = GENERATE(1, 2, 4, 7);
+    WorkerPool workerPool(threadCount);
+
+    TerminalCapabilities capabilities;
+    capabilities.backColorErase = true;
+    capabilities.eraseCharacters = true;
+    capabilities.repeatCharacter = true;
+    capabilities.scrollRegion = true;
+    capabilities.scrollUpDown = true;
+    capabilities.colors = ColorSupport::TrueColor;
+
+    // Screen is large enough to be fully repainted in bands.
+    Size size{128, 130};
+    REQUIRE(size.width * size.height >= ScreenBuffer::minCellsForParallelRepaint);
+
+    ScreenBuffer serial;
+    ScreenBuffer banded;
+    banded.setWorkerPool(&workerPool);
+    OutputBuffer serialOutput;
+    OutputBuffer bandedOutput;
+    TestTerminal serialTerminal(size);
+    TestTerminal bandedTerminal(size);
+    for (auto screenBuffer : {&serial, &banded}) {
+        screenBuffer->setTerminalCapabilities(capabilities);
+        screenBuffer->resize(size.width, size.height);
+    }
+    serial.setOutputCapture(&serialOutput);
+    banded.setOutputCapture(&bandedOutput);
+
+    // Rows from 5 to 120 show logical rows moved by given shift, so they are scrolled across band edges.
+    auto drawFrame = [&](int shift, bool fullRepaint) {
+        for (auto screenBuffer : {&serial, &banded}) {
+            for (int y = 0; y < size.height; ++y) {
+                drawTestRow(*screenBuffer, y, ((y >= 5) && (y < 120)) ? y + shift : y);
+            }
+            if (fullRepaint) {
+                screenBuffer->setFullRepaintNeeded();
+            }
+        }
+
+        serialOutput.clear();
+        bandedOutput.clear();
+        serial.present();
+        banded.present();
+        serialTerminal.write(serialOutput.str());
+        bandedTerminal.write(bandedOutput.str());
+        REQUIRE(bandedTerminal.cells() == serialTerminal.cells());
+
+        // Terminal shows the logical rows.
+        for (int y = 0; y < size.height; ++y) {
+            auto row = ((y >= 5) && (y < 120)) ? y + shift : y;
+            auto text = "row " + std::to_string(row);
+            for (size_t x = 0; x < text.size(); ++x) {
+                REQUIRE(serialTerminal.cells()[static_cast<size_t>(y * size.width) + x].text == text[x]);
+            }
+        }
+    };
+
+    // First frame is a full repaint.
+    drawFrame(0, false);
+
+    // Moved rows are scrolled. Both screen buffers draw it serially.
+    drawFrame(3, false);
+    REQUIRE(serialOutput.str().find("\x1B[6;123r\x1B[3S") != std::string::npos);
+
+    // Full repaint of a screen that was scrolled.
+    drawFrame(-2, true);
+    REQUIRE(bandedOutput.str() != serialOutput.str());
+
+    // Frame after full repaint is compared with the frame drawn in bands.
+    drawFrame(1, false);
+}
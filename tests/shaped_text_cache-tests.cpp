@@ -0,0 +1,70 @@
+#include "catch2/catch.hpp"
+
+#include "shaped_text_cache.h"
+
+using namespace terminal_editor;
+
+namespace {
+
+/// Restores textRendererWidthCache when it goes out of scope, so widths changed by a test don't leak into other tests.
+class WidthCacheRestorer {
+    CodePointWidthCache::State m_state;
+
+public:
+    WidthCacheRestorer()
+        : m_state(textRendererWidthCache.saveState()) {
+    }
+
+    ~WidthCacheRestorer() {
+        textRendererWidthCache.restoreState(std::move(m_state));
+    }
+
+    WidthCacheRestorer(const WidthCacheRestorer&) = delete;
+    WidthCacheRestorer& operator=(const WidthCacheRestorer&) = delete;
+};
+
+} // namespace
+
+TEST_CASE("ShapedTextCache keeps recently used texts", "[shaped-text-cache]") {
+    ShapedTextCache cache(2);
+
+    auto hello = cache.shape("Hello");
+    REQUIRE(hello->width == 5);
+    REQUIRE(hello->graphemes.size() == 5);
+    REQUIRE(hello->graphemes[0].consumedInput.empty());
+
+    SECTION("Same text is rendered once") {
+        REQUIRE(cache.shape("Hello") == hello);
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("Least recently used text is removed") {
+        auto world = cache.shape("World");
+        REQUIRE(cache.shape("Hello") == hello);
+        cache.shape("!");
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.shape("Hello") == hello);
+        REQUIRE(cache.shape("World") != world);
+    }
+
+    SECTION("Long texts are not cached") {
+        std::string longText(ShapedTextCache::maxTextSize + 1, 'x');
+        REQUIRE(cache.shape(longText)->width == static_cast<int>(longText.size()));
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("Texts are rendered again when widths change") {
+        WidthCacheRestorer widthCacheRestorer;
+
+        textRendererWidthCache.setWidth('H', 1);
+        auto rendered = cache.shape("Hello");
+
+        // Setting the same width doesn't invalidate the cache.
+        textRendererWidthCache.setWidth('H', 1);
+        REQUIRE(cache.shape("Hello") == rendered);
+
+        textRendererWidthCache.setWidth('H', 2);
+        REQUIRE(cache.shape("Hello") != rendered);
+        REQUIRE(cache.size() == 1);
+    }
+}
@@ -0,0 +1,210 @@
+#include "catch2/catch.hpp"
+
+#include "terminal_encoder.h"
+
+using namespace terminal_editor;
+
+TEST_CASE("TerminalEncoder chooses shortest cursor movement", "[terminal-encoder]") {
+    OutputBuffer output;
+    TerminalCapabilities capabilities;
+    TerminalEncoder encoder(output, capabilities, Size(100, 30));
+
+    SECTION("Unknown position uses CUP") {
+        encoder.moveTo(0, 0);
+        REQUIRE(output.str() == "\x1B[H");
+        output.clear();
+
+        TerminalEncoder otherEncoder(output, capabilities, Size(100, 30));
+        otherEncoder.moveTo(0, 4);
+        REQUIRE(output.str() == "\x1B[5H");
+        output.clear();
+
+        TerminalEncoder thirdEncoder(output, capabilities, Size(100, 30));
+        thirdEncoder.moveTo(9, 4);
+        REQUIRE(output.str() == "\x1B[5;10H");
+    }
+
+    SECTION("Relative movements") {
+        encoder.moveTo(10, 10);
+        output.clear();
+
+        encoder.moveTo(10, 10);
+        REQUIRE(output.str() == "");
+
+        encoder.moveTo(11, 10);
+        REQUIRE(output.str() == "\x1B[C");
+        output.clear();
+
+        encoder.moveTo(20, 10);
+        REQUIRE(output.str() == "\x1B[9C");
+        output.clear();
+
+        encoder.moveTo(18, 10);
+        REQUIRE(output.str() == "\b\b");
+        output.clear();
+
+        encoder.moveTo(18, 11);
+        REQUIRE(output.str() == "\n");
+        output.clear();
+
+        encoder.moveTo(0, 12);
+        REQUIRE(output.str() == "\n\r");
+        output.clear();
+
+        encoder.moveTo(0, 5);
+        REQUIRE(output.str() == "\x1B[6H");
+        output.clear();
+
+        encoder.moveTo(0, 7);
+        REQUIRE(output.str() == "\n\n");
+
+        encoder.moveTo(50, 20);
+        output.clear();
+
+        encoder.moveTo(50, 18);
+        REQUIRE(output.str() == "\x1B[2A");
+    }
+
+    SECTION("Column is unknown after writing to the last column") {
+        encoder.moveTo(98, 3);
+        encoder.print({"ab", 2}, 2);
+        REQUIRE(encoder.getCursorX() == -1);
+        REQUIRE(encoder.getCursorY() == 3);
+        output.clear();
+
+        encoder.moveTo(0, 4);
+        REQUIRE(output.str() == "\n\r");
+        output.clear();
+
+        encoder.moveTo(97, 4);
+        encoder.print({"a", 1}, 1);
+        encoder.print({"b", 1}, 1);
+        encoder.print({"c", 1}, 1);
+        output.clear();
+
+        encoder.moveTo(50, 4);
+        REQUIRE(output.str() == "\x1B[51G");
+    }
+}
+
+TEST_CASE("TerminalEncoder erases and repeats", "[terminal-encoder]") {
+    OutputBuffer output;
+    TerminalCapabilities capabilities;
+    capabilities.eraseCharacters = true;
+    capabilities.repeatCharacter = true;
+    TerminalEncoder encoder(output, capabilities, Size(100, 30));
+
+    encoder.moveTo(10, 10);
+    output.clear();
+
+    encoder.eraseCharacters(20);
+    encoder.eraseToEndOfLine();
+    REQUIRE(output.str() == "\x1B[20X\x1B[K");
+    REQUIRE(encoder.isCursorAt(10, 10));
+    output.clear();
+
+    encoder.print({"-", 1}, 1);
+    encoder.repeat(30);
+    REQUIRE(output.str() == "-\x1B[30b");
+    REQUIRE(encoder.isCursorAt(41, 10));
+}
+
+TEST_CASE("Terminal capabilities are guessed from TERM", "[terminal-encoder]") {
+    auto xterm = getTerminalCapabilities("xterm-256color");
+    REQUIRE(xterm.backColorErase);
+    REQUIRE(xterm.eraseCharacters);
+    REQUIRE(!xterm.repeatCharacter);
+
+    REQUIRE(xterm.colors == ColorSupport::Colors256);
+
+    auto screen = getTerminalCapabilities("screen");
+    REQUIRE(!screen.backColorErase);
+    REQUIRE(screen.colors == ColorSupport::Colors16);
+
+    auto unknown = getTerminalCapabilities("dumb");
+    REQUIRE(!unknown.backColorErase);
+    REQUIRE(!unknown.eraseCharacters);
+    REQUIRE(!unknown.repeatCharacter);
+}
+
+TEST_CASE("TerminalEncoder scrolls regions", "[terminal-encoder]") {
+    OutputBuffer output;
+    TerminalCapabilities capabilities;
+    capabilities.scrollRegion = true;
+
+    SECTION("With SU and SD") {
+        capabilities.scrollUpDown = true;
+        TerminalEncoder encoder(output, capabilities, Size(100, 30));
+
+        encoder.scrollRows(2, 20, 3);
+        REQUIRE(output.str() == "\x1B[3;21r\x1B[3S\x1B[r");
+        REQUIRE(encoder.getCursorY() == -1);
+        output.clear();
+
+        encoder.scrollRows(0, 29, -1);
+        REQUIRE(output.str() == "\x1B[T");
+    }
+
+    SECTION("With line feed and reverse index") {
+        TerminalEncoder encoder(output, capabilities, Size(100, 30));
+
+        encoder.scrollRows(2, 20, 2);
+        REQUIRE(output.str() == "\x1B[3;21r\x1B[21H\n\n\x1B[r");
+        output.clear();
+
+        encoder.scrollRows(2, 20, -2);
+        REQUIRE(output.str() == "\x1B[3;21r\x1B[3H\x1BM\x1BM\x1B[r");
+    }
+}
+
+TEST_CASE("TerminalEncoder emits only changed SGR parameters", "[terminal-encoder]") {
+    OutputBuffer output;
+    TerminalCapabilities capabilities;
+    capabilities.colors = ColorSupport::TrueColor;
+    TerminalEncoder encoder(output, capabilities, Size(100, 30));
+
+    encoder.setAttributes({Color::White, Color::Blue, Style::Normal});
+    REQUIRE(output.str() == "\x1B[0;37;44m");
+    output.clear();
+
+    encoder.setAttributes({Color::White, Color::Blue, Style::Normal});
+    REQUIRE(output.str() == "");
+
+    encoder.setAttributes({Color::Red, Color::Blue, Style::Bold | Style::Underline});
+    REQUIRE(output.str() == "\x1B[1;4;31m");
+    output.clear();
+
+    encoder.setAttributes({Color::Red, rgbColor(1, 2, 3), Style::Underline});
+    REQUIRE(output.str() == "\x1B[22;48;2;1;2;3m");
+    output.clear();
+
+    // Reset is shorter than turning off both flags.
+    encoder.setAttributes({Color::Default, Color::Default, Style::Normal});
+    REQUIRE(output.str() == "\x1B[0m");
+    output.clear();
+
+    encoder.setAttributes({indexedColor(200), indexedColor(9), Style::Normal});
+    REQUIRE(output.str() == "\x1B[38;5;200;101m");
+    REQUIRE(encoder.hasAttributes({indexedColor(200), Color::Bright_Red, Style::Normal}));
+}
+
+TEST_CASE("TerminalEncoder replaces unsupported colors", "[terminal-encoder]") {
+    OutputBuffer output;
+    TerminalCapabilities capabilities;
+
+    SECTION("16 colors") {
+        TerminalEncoder encoder(output, capabilities, Size(100, 30));
+        REQUIRE(encoder.supportedColor(rgbColor(250, 10, 10)) == Color::Bright_Red);
+        REQUIRE(encoder.supportedColor(indexedColor(4)) == Color::Blue);
+        REQUIRE(encoder.supportedColor(indexedColor(231)) == Color::Bright_White);
+        REQUIRE(encoder.supportedColor(Color::Green) == Color::Green);
+    }
+
+    SECTION("256 colors") {
+        capabilities.colors = ColorSupport::Colors256;
+        TerminalEncoder encoder(output, capabilities, Size(100, 30));
+        REQUIRE(encoder.supportedColor(rgbColor(255, 0, 0)) == indexedColor(196));
+        REQUIRE(encoder.supportedColor(rgbColor(128, 128, 128)) == indexedColor(244));
+        REQUIRE(encoder.supportedColor(indexedColor(100)) == indexedColor(100));
+    }
+}
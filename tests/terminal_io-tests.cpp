@@ -0,0 +1,50 @@
+#include "catch2/catch.hpp"
+
+#include "terminal_io.h"
+
+#include <vector>
+
+using namespace terminal_editor;
+
+namespace {
+
+std::vector<int> toVector(const CsiParams& params) {
+    auto values = params.get();
+    return std::vector<int>(values.begin(), values.end());
+}
+
+} // namespace
+
+TEST_CASE("CSI parameters are parsed", "[terminal-io]") {
+    SECTION("Empty parameters are zeros") {
+        auto params = parseCsiParams("");
+        REQUIRE(params);
+        REQUIRE(params->count == 0);
+
+        params = parseCsiParams("1;;5;");
+        REQUIRE(params);
+        REQUIRE(params->privateMarker == 0);
+        REQUIRE(toVector(*params) == std::vector<int>{1, 0, 5, 0});
+    }
+
+    SECTION("Private marker") {
+        auto params = parseCsiParams("<35;120;41");
+        REQUIRE(params);
+        REQUIRE(params->privateMarker == '<');
+        REQUIRE(toVector(*params) == std::vector<int>{35, 120, 41});
+
+        REQUIRE(!parseCsiParams("1;?2"));
+    }
+
+    SECTION("Unsupported parameters") {
+        REQUIRE(!parseCsiParams("4:3"));
+        REQUIRE(parseCsiParams(std::string(CsiParams::maxCount - 1, ';')));
+        REQUIRE(!parseCsiParams(std::string(CsiParams::maxCount, ';')));
+    }
+
+    SECTION("Large parameters are saturated") {
+        auto params = parseCsiParams("99999999999999999999");
+        REQUIRE(params);
+        REQUIRE(params->values[0] == std::numeric_limits<int>::max());
+    }
+}
@@ -0,0 +1,64 @@
+#include "catch2/catch.hpp"
+
+#include "worker_pool.h"
+#include "zerrors.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace terminal_editor;
+
+TEST_CASE("WorkerPool runs all parts of a job", "[worker-pool]") {
+    auto threadCount = GENERATE(0, 1, 3);
+    WorkerPool workerPool(threadCount);
+
+    SECTION("Each part is processed once") {
+        std::vector<int> processed(100, 0);
+        workerPool.run(static_cast<int>(processed.size()), [&processed](int index) { processed[static_cast<size_t>(index)] += 1; });
+        REQUIRE(processed == std::vector<int>(100, 1));
+
+        // Pool can be reused.
+        workerPool.run(static_cast<int>(processed.size()), [&processed](int index) { processed[static_cast<size_t>(index)] += 1; });
+        REQUIRE(processed == std::vector<int>(100, 2));
+    }
+
+    SECTION("Errors are rethrown") {
+        struct PartError {
+            int index;
+        };
+
+        // Failing part is the last one, so all other parts have started before it fails.
+        std::atomic<int> count{0};
+        int failedIndex = -1;
+        try {
+            workerPool.run(10, [&count](int index) {
+                ++count;
+                if (index == 9) {
+                    throw PartError{index};
+                }
+            });
+        }
+        catch (const PartError& error) {
+            failedIndex = error.index;
+        }
+        REQUIRE(failedIndex == 9);
+        REQUIRE(count == 10);
+
+        workerPool.run(10, [&count](int) { ++count; });
+        REQUIRE(count == 20);
+    }
+}
+
+TEST_CASE("WorkerPool skips parts after an error", "[worker-pool]") {
+    // Without worker threads parts run in order, so no part runs after the failing one.
+    WorkerPool workerPool(0);
+
+    int count = 0;
+    REQUIRE_THROWS_WITH(workerPool.run(10, [&count](int index) {
+        ++count;
+        if (index == 2) {
+            ZTHROW() << "Part failed.";
+        }
+    }), Catch::Contains("Part failed."));
+    REQUIRE(count == 3);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "action_id.h"
+#include "zerrors.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace terminal_editor {
+
+/// ActionTable maps actions to their handlers, so processing an action takes one lookup instead of comparing action names.
+/// Every window class that processes actions keeps one static table of it's handlers.
+/// @param Target   Class that handlers act on.
+template<typename Target>
+class ActionTable {
+public:
+    using Handler = std::function<void(Target& target)>;
+
+private:
+    std::vector<Handler> m_handlers;    ///< Handler of each action, indexed by ActionId::getIndex(). Empty for actions without a handler.
+
+public:
+    /// Registers handler of given action. Each action can have only one handler.
+    /// @param actionName   Name of the action. It is interned.
+    ActionTable& add(const std::string& actionName, Handler handler) {
+        auto index = static_cast<size_t>(ActionId(actionName).getIndex());
+        if (index >= m_handlers.size()) {
+            m_handlers.resize(index + 1);
+        }
+        ZASSERT(!m_handlers[index]) << "Action has a handler already: " << actionName;
+        m_handlers[index] = std::move(handler);
+        return *this;
+    }
+
+    /// Calls handler of given action.
+    /// @return False if action has no handler.
+    bool dispatch(Target& target, ActionId action) const {
+        auto index = static_cast<size_t>(action.getIndex());
+        if ((index >= m_handlers.size()) || !m_handlers[index])
+            return false;
+
+        m_handlers[index](target);
+        return true;
+    }
+};
+
+} // namespace terminal_editor
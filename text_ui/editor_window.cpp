@@ -5,31 +5,93 @@
 
 namespace terminal_editor {
 
-void EditorWindow::drawSelf(ScreenCanvas& windowCanvas) {
-    auto localRect = Rect{Point{0, 0}, getRect().size};
-    auto attributes = m_normalAttributes;
-    if (getWindowManager()->getFocusedWindow() == this) {
-        attributes.fgColor = Color::Bright_Red;
+/// Snapshot of an EditorWindow.
+/// Only lines visible in the window and overlapping the dirty region are copied, and only their visible graphemes.
+class EditorWindowSnapshot : public WindowSnapshot {
+public:
+    explicit EditorWindowSnapshot(FrameArena& arena)
+        : WindowSnapshot(arena)
+        , graphemes(ArenaAllocator<Grapheme>(arena))
+        , lineStarts(ArenaAllocator<size_t>(arena))
+        , lineOffsets(ArenaAllocator<int>(arena)) {
     }
-    windowCanvas.fillRect(localRect, m_doubleEdge, true, attributes);
 
-    auto textCanvas = windowCanvas.getSubCanvas({{1, 1}, Size{localRect.size.width - 2, localRect.size.height - 2}});
+    bool doubleEdge;
+    Attributes frameAttributes;
+    Attributes normalAttributes;
+    Attributes invalidAttributes;
+    Attributes replacementAttributes;
+    Point topLeftPosition;                      ///< Position of the top-left corner of the window inside the text.
+    ArenaVector<Grapheme> graphemes;            ///< Visible parts of lines, starting from topLeftPosition.y, one after another. Lines that won't be drawn are empty.
+    ArenaVector<size_t> lineStarts;             ///< Index of first grapheme of each visible line, followed by number of graphemes.
+    ArenaVector<int> lineOffsets;               ///< Column inside the window where each visible part of line starts. Can be negative if first grapheme is partially visible.
+    Point cursorPoint;                          ///< Position of the cursor inside the text, in screen coordinates.
+    bool nativeCursor;                          ///< If true, hardware cursor is shown instead of painting the cursor.
+    std::string textUnderCursor;
+    Attributes cursorAttributes;
+
+private:
+    void drawSelf(ScreenCanvas& windowCanvas) const override {
+        auto localRect = Rect{Point{0, 0}, rect.size};
+        windowCanvas.fillRect(localRect, doubleEdge, true, frameAttributes);
+
+        auto textCanvas = windowCanvas.getSubCanvas({{1, 1}, Size{localRect.size.width - 2, localRect.size.height - 2}});
+
+        // Print text.
+        for (int i = 0; i < static_cast<int>(lineOffsets.size()); ++i) {
+            auto line = gsl::span<const Grapheme>(graphemes.data() + lineStarts[i], graphemes.data() + lineStarts[i + 1]);
+            textCanvas.print(Point{lineOffsets[i], i}, line, normalAttributes, invalidAttributes, replacementAttributes);
+        }
 
-    // Print text.
-    for (int i = 0; i < localRect.size.height - 2; ++i) {
-        auto line = m_graphemeBuffer.getLine(m_topLeftPosition.y + i);
-        textCanvas.print(Point{-m_topLeftPosition.x, i}, line, m_normalAttributes, m_invalidAttributes, m_replacementAttributes);
+        // Print cursor.
+        if (nativeCursor)
+            return;
+        textCanvas.print(cursorPoint - topLeftPosition.asSize(), textUnderCursor, cursorAttributes, cursorAttributes, cursorAttributes);
+    }
+};
+
+WindowSnapshot* EditorWindow::snapshotSelf(const Region& dirtyRegion, FrameArena& arena) const {
+    auto windowSnapshot = arena.create<EditorWindowSnapshot>(arena);
+    windowSnapshot->doubleEdge = m_doubleEdge;
+    windowSnapshot->frameAttributes = m_normalAttributes;
+    windowSnapshot->nativeCursor = getEditorConfig().nativeCursor;
+    if (isFocused()) {
+        windowSnapshot->frameAttributes.fgColor = Color::Bright_Red;
+    }
+    windowSnapshot->normalAttributes = m_normalAttributes;
+    windowSnapshot->invalidAttributes = m_invalidAttributes;
+    windowSnapshot->replacementAttributes = m_replacementAttributes;
+    windowSnapshot->topLeftPosition = m_topLeftPosition;
+
+    auto screenRect = getScreenRect();
+    auto textWidth = std::max(0, screenRect.size.width - 2);
+    auto textHeight = std::max(0, screenRect.size.height - 2);
+    windowSnapshot->lineStarts.reserve(static_cast<size_t>(textHeight) + 1);
+    windowSnapshot->lineOffsets.resize(static_cast<size_t>(textHeight));
+    windowSnapshot->lineStarts.push_back(0);
+    for (int i = 0; i < textHeight; ++i) {
+        auto rowRect = Rect{screenRect.topLeft + Size{0, 1 + i}, Size{screenRect.size.width, 1}};
+        auto isDirty = std::any_of(dirtyRegion.rects().begin(), dirtyRegion.rects().end(), [rowRect](Rect dirtyRect) { return dirtyRect.overlap(rowRect); });
+        if (isDirty) {
+            int firstColumn;
+            auto line = m_graphemeBuffer.getScreenRange(m_topLeftPosition.y + i, m_topLeftPosition.x, m_topLeftPosition.x + textWidth, firstColumn);
+            windowSnapshot->lineOffsets[i] = firstColumn - m_topLeftPosition.x;
+            for (auto& grapheme : line) {
+                // Snapshot must not refer to text buffer's data, which can change. Info is not drawn, so it is not copied.
+                windowSnapshot->graphemes.push_back(Grapheme{grapheme.kind, grapheme.rendered, std::string(), grapheme.width, {}});
+            }
+        }
+        windowSnapshot->lineStarts.push_back(windowSnapshot->graphemes.size());
     }
 
-    // Print cursor.
     // Compute grapheme under cursor.
     auto graphemes = m_graphemeBuffer.getLineRange(m_editCursorPosition.row, m_editCursorPosition.column, m_editCursorPosition.column + 1);
     auto textUnderCursorKind = GraphemeKind::NORMAL;
-    std::string textUnderCursor(" ");
+    windowSnapshot->textUnderCursor = " ";
     if (graphemes.size() > 0) {
         auto grapheme = graphemes[0];
         textUnderCursorKind = grapheme.kind;
-        textUnderCursor = grapheme.rendered;
+        windowSnapshot->textUnderCursor = grapheme.rendered;
     }
 
     Attributes cursorAttributes = m_normalAttributes;
@@ -37,10 +99,10 @@ void EditorWindow::drawSelf(ScreenCanvas& windowCanvas) {
         cursorAttributes = m_invalidAttributes;
     if (textUnderCursorKind == GraphemeKind::REPLACEMENT)
         cursorAttributes = m_replacementAttributes;
-    cursorAttributes = { cursorAttributes.bgColor, cursorAttributes.fgColor, Style::Bold };
+    windowSnapshot->cursorAttributes = { cursorAttributes.bgColor, cursorAttributes.fgColor, Style::Bold };
 
-    auto editPoint = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-    textCanvas.print(editPoint - m_topLeftPosition.asSize(), textUnderCursor, cursorAttributes, cursorAttributes, cursorAttributes);
+    windowSnapshot->cursorPoint = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
+    return windowSnapshot;
 }
 
 /// Returns rendered position that is equivalent to given text bufer position.
@@ -244,200 +306,231 @@ void EditorWindow::updateViewPosition() {
     m_topLeftPosition = rect.topLeft;
 }
 
-bool EditorWindow::doProcessAction(const std::string& action) {
-    if (action == "cursor-document-start") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = Position{0, 0};
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-document-end") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = Position{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
-        m_editCursorPosition = m_graphemeBuffer.clampPosition(m_editCursorPosition);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-page-up") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition.row -= getRect().size.height - 2 - 1;
-        m_editCursorPosition = m_graphemeBuffer.clampPosition(m_editCursorPosition);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-page-down") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition.row += getRect().size.height - 2 - 1;
-        m_editCursorPosition = m_graphemeBuffer.clampPosition(m_editCursorPosition);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-line-start") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition.column = 0;
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-line-end") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition.column = std::numeric_limits<int>::max();
-        m_editCursorPosition = m_graphemeBuffer.clampPosition(m_editCursorPosition);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-left") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = moveCursorLeftRight(m_graphemeBuffer, m_editCursorPosition, -1);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-right") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = moveCursorLeftRight(m_graphemeBuffer, m_editCursorPosition, 1);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-word-left") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = moveWordLeftRight(m_graphemeBuffer, m_editCursorPosition, false);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
+tl::optional<Point> EditorWindow::getCursorPosition() const {
+    if (!getEditorConfig().nativeCursor)
+        return tl::nullopt;
 
-    if (action == "cursor-word-right") {
-        // @note Virtual position will become concrete.
-        m_editCursorPosition = moveWordLeftRight(m_graphemeBuffer, m_editCursorPosition, true);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
+    auto textRect = Rect{Point{1, 1}, getRect().size - Size{2, 2}};
+    auto cursorPoint = m_graphemeBuffer.positionToPoint(m_editCursorPosition) - m_topLeftPosition.asSize() + Size{1, 1};
+    if (!textRect.contains(cursorPoint))
+        return tl::nullopt;
 
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-up") {
-        // @note We don't change virtual column here.
-        m_virtualCursorPosition.y -= 1;
-        m_editCursorPosition = m_graphemeBuffer.pointToPosition(m_virtualCursorPosition, false);
-        m_virtualCursorPosition.y = m_editCursorPosition.row;
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "cursor-down") {
-        // @note We don't change virtual column here.
-        m_virtualCursorPosition.y += 1;
-        m_editCursorPosition = m_graphemeBuffer.pointToPosition(m_virtualCursorPosition, false);
-        m_virtualCursorPosition.y = m_editCursorPosition.row;
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "view-wheel-up") {
-        m_topLeftPosition.y -= getEditorConfig().mouseWheelScrollLines;
-        if (m_topLeftPosition.y < 0)
-            m_topLeftPosition.y = 0;
-        return true;
-    }
-
-    if (action == "view-wheel-down") {
-        m_topLeftPosition.y += getEditorConfig().mouseWheelScrollLines;
-        if (m_topLeftPosition.y >= m_graphemeBuffer.getNumberOfLines())
-            m_topLeftPosition.y = m_graphemeBuffer.getNumberOfLines() - 1;
-        return true;
-    }
-
-    if (action == "text-backspace") {
-        // @note Virtual position will become concrete.
-        auto startPosition = moveCursorLeftRight(m_graphemeBuffer, m_editCursorPosition, -1);
-        m_graphemeBuffer.deleteText(startPosition, m_editCursorPosition);
-        m_editCursorPosition = startPosition;
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "text-tab") {
-        // @note Virtual position will become concrete.
-        std::string tab(getEditorConfig().tabWidth, ' ');
-        doProcessTextInput(tab);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "text-delete") {
-        // @note Virtual position will become concrete.
-        auto endPosition = moveCursorLeftRight(m_graphemeBuffer, m_editCursorPosition, 1);
-        m_graphemeBuffer.deleteText(m_editCursorPosition, endPosition);
-        m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
-
-        updateViewPosition();
-        return true;
-    }
-
-    if (action == "text-new-line") {
-        doProcessTextInput("\n");
+    return cursorPoint + getScreenRect().topLeft.asSize();
+}
 
-        updateViewPosition();
-        return true;
+void EditorWindow::invalidateChanges(const ViewState& oldState) {
+    auto newState = getViewState();
+    if (newState.topLeftPosition != oldState.topLeftPosition) {
+        invalidate();
+        return;
     }
 
-    if (action == "size-left") {
-        getRect().size.width -= 1;
-        return true;
-    }
+    // Convert text rows to window rows, clamped to the text area.
+    auto width = getRect().size.width - 2;
+    auto height = getRect().size.height - 2;
+    auto toWindowRow = [this, height](int row) {
+        return std::max(0, std::min(height, row - m_topLeftPosition.y)) + 1;
+    };
 
-    if (action == "size-right") {
-        getRect().size.width += 1;
-        return true;
-    }
+    auto firstRow = toWindowRow(std::min(oldState.cursorRow, newState.cursorRow));
+    auto endRow = toWindowRow(std::max(oldState.cursorRow, newState.cursorRow) + 1);
+    if (newState.numberOfLines != oldState.numberOfLines)
+        endRow = height + 1;
 
-    if (action == "size-up") {
-        getRect().size.height -= 1;
-        return true;
-    }
+    if (width > 0 && endRow > firstRow)
+        invalidate(Rect{Point{1, firstRow}, Size{width, endRow - firstRow}});
+}
 
-    if (action == "size-down") {
-        getRect().size.height += 1;
+bool EditorWindow::doProcessAction(ActionId action) {
+    auto viewState = getViewState();
+    if (getActionTable().dispatch(*this, action)) {
+        invalidateChanges(viewState);
         return true;
     }
 
+    // @note Window may be closed by this, so it must be the last thing done.
     return Window::doProcessAction(action);
 }
 
+const ActionTable<EditorWindow>& EditorWindow::getActionTable() {
+    static const auto actionTable = []() {
+        ActionTable<EditorWindow> table;
+
+        table.add("cursor-document-start", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = Position{0, 0};
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-document-end", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = Position{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+            window.m_editCursorPosition = window.m_graphemeBuffer.clampPosition(window.m_editCursorPosition);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-page-up", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition.row -= window.getRect().size.height - 2 - 1;
+            window.m_editCursorPosition = window.m_graphemeBuffer.clampPosition(window.m_editCursorPosition);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-page-down", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition.row += window.getRect().size.height - 2 - 1;
+            window.m_editCursorPosition = window.m_graphemeBuffer.clampPosition(window.m_editCursorPosition);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-line-start", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition.column = 0;
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-line-end", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition.column = std::numeric_limits<int>::max();
+            window.m_editCursorPosition = window.m_graphemeBuffer.clampPosition(window.m_editCursorPosition);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-left", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = moveCursorLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, -1);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-right", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = moveCursorLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, 1);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-word-left", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = moveWordLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, false);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-word-right", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            window.m_editCursorPosition = moveWordLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, true);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-up", [](EditorWindow& window) {
+            // @note We don't change virtual column here.
+            window.m_virtualCursorPosition.y -= 1;
+            window.m_editCursorPosition = window.m_graphemeBuffer.pointToPosition(window.m_virtualCursorPosition, false);
+            window.m_virtualCursorPosition.y = window.m_editCursorPosition.row;
+
+            window.updateViewPosition();
+        });
+
+        table.add("cursor-down", [](EditorWindow& window) {
+            // @note We don't change virtual column here.
+            window.m_virtualCursorPosition.y += 1;
+            window.m_editCursorPosition = window.m_graphemeBuffer.pointToPosition(window.m_virtualCursorPosition, false);
+            window.m_virtualCursorPosition.y = window.m_editCursorPosition.row;
+
+            window.updateViewPosition();
+        });
+
+        table.add("view-wheel-up", [](EditorWindow& window) {
+            window.m_topLeftPosition.y -= getEditorConfig().mouseWheelScrollLines;
+            if (window.m_topLeftPosition.y < 0)
+                window.m_topLeftPosition.y = 0;
+        });
+
+        table.add("view-wheel-down", [](EditorWindow& window) {
+            window.m_topLeftPosition.y += getEditorConfig().mouseWheelScrollLines;
+            if (window.m_topLeftPosition.y >= window.m_graphemeBuffer.getNumberOfLines())
+                window.m_topLeftPosition.y = window.m_graphemeBuffer.getNumberOfLines() - 1;
+        });
+
+        table.add("text-backspace", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            auto startPosition = moveCursorLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, -1);
+            window.m_graphemeBuffer.deleteText(startPosition, window.m_editCursorPosition);
+            window.m_editCursorPosition = startPosition;
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("text-tab", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            std::string tab(getEditorConfig().tabWidth, ' ');
+            window.doProcessTextInput(tab);
+
+            window.updateViewPosition();
+        });
+
+        table.add("text-delete", [](EditorWindow& window) {
+            // @note Virtual position will become concrete.
+            auto endPosition = moveCursorLeftRight(window.m_graphemeBuffer, window.m_editCursorPosition, 1);
+            window.m_graphemeBuffer.deleteText(window.m_editCursorPosition, endPosition);
+            window.m_virtualCursorPosition = window.m_graphemeBuffer.positionToPoint(window.m_editCursorPosition);
+
+            window.updateViewPosition();
+        });
+
+        table.add("text-new-line", [](EditorWindow& window) {
+            window.doProcessTextInput("\n");
+
+            window.updateViewPosition();
+        });
+
+        table.add("size-left", [](EditorWindow& window) {
+            window.resizeBy(Size{-1, 0});
+        });
+
+        table.add("size-right", [](EditorWindow& window) {
+            window.resizeBy(Size{1, 0});
+        });
+
+        table.add("size-up", [](EditorWindow& window) {
+            window.resizeBy(Size{0, -1});
+        });
+
+        table.add("size-down", [](EditorWindow& window) {
+            window.resizeBy(Size{0, 1});
+        });
+
+        return table;
+    }();
+    return actionTable;
+}
+
 bool EditorWindow::doProcessTextInput(const std::string& text) {
+    auto viewState = getViewState();
     m_editCursorPosition = m_graphemeBuffer.insertText(m_editCursorPosition, text);
     m_virtualCursorPosition = m_graphemeBuffer.positionToPoint(m_editCursorPosition);
 
     updateViewPosition();
+    invalidateChanges(viewState);
     return true;
 }
 
@@ -449,10 +542,12 @@ bool EditorWindow::doProcessMouseEvent(const MouseEvent& mouseEvent) {
     if (!screenRect.contains(mouseEvent.position))
         return false;
 
+    auto viewState = getViewState();
     auto point = mouseEvent.position - screenRect.topLeft.asSize();
     m_virtualCursorPosition = m_topLeftPosition + point.asSize();
     m_editCursorPosition = m_graphemeBuffer.pointToPosition(m_virtualCursorPosition, false);
 
+    invalidateChanges(viewState);
     return true;
 }
 
@@ -29,22 +29,44 @@ public:
     {}
 
     void loadFile(const std::string& fileName) {
-        return m_graphemeBuffer.loadFile(fileName);
+        m_graphemeBuffer.loadFile(fileName);
+        invalidate();
     }
 
+    tl::optional<Point> getCursorPosition() const override;
+
 private:
     /// Updates m_topLeftPosition to make m_editCursorPosition visible.
     void updateViewPosition();
 
+    /// State of the view that is compared before and after processing an event, to find out what to redraw.
+    struct ViewState {
+        Point topLeftPosition;
+        int cursorRow;
+        int numberOfLines;
+    };
+
+    ViewState getViewState() const {
+        return { m_topLeftPosition, m_editCursorPosition.row, m_graphemeBuffer.getNumberOfLines() };
+    }
+
+    /// Invalidates part of the window that could have changed since given state was taken.
+    /// Scrolling invalidates whole window. Otherwise only rows between old and new cursor are invalidated,
+    /// or all rows below them if number of lines changed.
+    void invalidateChanges(const ViewState& oldState);
+
 private:
-    void drawSelf(ScreenCanvas& windowCanvas) override;
+    WindowSnapshot* snapshotSelf(const Region& dirtyRegion, FrameArena& arena) const override;
+
+    /// Returns handlers of actions specific to the editor window.
+    static const ActionTable<EditorWindow>& getActionTable();
 
 protected:
     std::string getInputContextName() const override {
         return "text-editor";
     }
         
-    bool doProcessAction(const std::string& action) override;
+    bool doProcessAction(ActionId action) override;
 
     bool doProcessTextInput(const std::string& text) override;
 
@@ -0,0 +1,81 @@
+#include "frame_scheduler.h"
+
+#include "zerrors.h"
+
+#include <algorithm>
+
+namespace terminal_editor {
+
+FrameScheduler::FrameScheduler(int maxFps)
+    : m_frameInterval(Clock::duration::zero())
+    , m_frameRequested(false) {
+    setMaxFps(maxFps);
+}
+
+void FrameScheduler::setMaxFps(int maxFps) {
+    ZASSERT(maxFps >= 0) << "Invalid maximal number of frames per second: " << maxFps;
+
+    if (maxFps == 0) {
+        m_frameInterval = Clock::duration::zero();
+    } else {
+        m_frameInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / maxFps;
+    }
+}
+
+void FrameScheduler::requestFrame(Clock::time_point now) {
+    if (m_frameRequested)
+        return;
+
+    m_frameRequested = true;
+    m_requestTime = now;
+}
+
+bool FrameScheduler::isFrameDue(Clock::time_point now, bool inputPending) const {
+    if (!m_frameRequested)
+        return false;
+
+    // Last event was processed, so its result is shown right away.
+    if (!inputPending)
+        return true;
+
+    // Input storm: draw at most one frame per frame interval, but at least one frame interval after it was requested.
+    return (now >= m_lastFrameTime + m_frameInterval) && (now >= m_requestTime + m_frameInterval);
+}
+
+void FrameScheduler::frameDrawn(Clock::time_point now) {
+    m_frameRequested = false;
+    m_lastFrameTime = now;
+}
+
+FrameScheduler::Clock::time_point FrameScheduler::getWaitDeadline(Clock::time_point now) const {
+    if (m_frameRequested)
+        return std::max(now, std::max(m_lastFrameTime, m_requestTime) + m_frameInterval);
+
+    if (!m_idleTasks.empty())
+        return now;
+
+    return Clock::time_point::max();
+}
+
+void FrameScheduler::addIdleTask(IdleTask idleTask) {
+    m_idleTasks.push_back(std::move(idleTask));
+}
+
+int FrameScheduler::runIdleTasks(Clock::time_point deadline, const std::function<bool()>& inputPending) {
+    int steps = 0;
+    while (!m_idleTasks.empty()) {
+        auto idleTask = std::move(m_idleTasks.front());
+        m_idleTasks.pop_front();
+        if (idleTask()) {
+            m_idleTasks.push_back(std::move(idleTask));
+        }
+        ++steps;
+
+        if ((Clock::now() >= deadline) || inputPending())
+            break;
+    }
+
+    return steps;
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace terminal_editor {
+
+/// FrameScheduler decides when the main loop should draw a frame.
+/// Frames are drawn at most maxFps times per second. Changes made while input is pending are coalesced into one frame,
+/// but a frame is drawn at least once per frame interval, even if input never stops coming.
+/// Frame is drawn right away once there is no more input.
+/// Background work is done in idle tasks, that run between frames, until the next frame is due or input arrives.
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Idle task does a small part of background work.
+    /// @return True if task has more work to do, and should be run again.
+    using IdleTask = std::function<bool()>;
+
+private:
+    Clock::duration m_frameInterval;        ///< Minimal time between frames.
+    Clock::time_point m_lastFrameTime;      ///< Time when last frame was drawn.
+    Clock::time_point m_requestTime;        ///< Time when first change since the last frame was made.
+    bool m_frameRequested;                  ///< True if something changed since the last frame.
+    std::deque<IdleTask> m_idleTasks;       ///< Idle tasks, run in round robin.
+
+public:
+    /// @param maxFps   Maximal number of frames per second. Zero means no limit.
+    explicit FrameScheduler(int maxFps);
+
+    /// Sets maximal number of frames per second. Zero means no limit.
+    void setMaxFps(int maxFps);
+
+    /// Marks that the screen has to be redrawn.
+    void requestFrame(Clock::time_point now);
+
+    bool isFrameRequested() const {
+        return m_frameRequested;
+    }
+
+    /// Returns true if requested frame should be drawn now.
+    /// If no input is pending frame is drawn right away, so the result of the last event is shown without delay.
+    /// If input is pending frames are drawn at most once per frame interval, and frame is delayed to coalesce more changes,
+    /// but no longer than one frame interval since it was requested.
+    /// @param inputPending     True if there are input events waiting to be processed.
+    bool isFrameDue(Clock::time_point now, bool inputPending) const;
+
+    /// Must be called after a frame is drawn.
+    void frameDrawn(Clock::time_point now);
+
+    /// Returns time until which the main loop can wait for input.
+    /// It is the time when requested frame will be due while input is pending, now if idle tasks are waiting, or Clock::time_point::max() if there is nothing to do.
+    Clock::time_point getWaitDeadline(Clock::time_point now) const;
+
+    /// Adds background task that will be run between frames.
+    void addIdleTask(IdleTask idleTask);
+
+    bool hasIdleTasks() const {
+        return !m_idleTasks.empty();
+    }
+
+    /// Runs steps of idle tasks in round robin, until all of them have finished, deadline passes, or input arrives.
+    /// At least one step is run if there are idle tasks. Task is removed once it has finished.
+    /// @param deadline         Time when the next frame is due, usually from getWaitDeadline().
+    /// @param inputPending     Returns true if input events are waiting. It is checked after each step.
+    /// @return Number of steps that were run.
+    int runIdleTasks(Clock::time_point deadline, const std::function<bool()>& inputPending);
+};
+
+} // namespace terminal_editor
@@ -0,0 +1,102 @@
+#include "glyph_table.h"
+
+#include "zerrors.h"
+
+#include <algorithm>
+
+namespace terminal_editor {
+
+Glyph GlyphTable::intern(gsl::span<const char> text) {
+    Glyph glyph{};
+
+    if (text.size() <= static_cast<gsl::span<const char>::index_type>(sizeof(glyph.bytes))) {
+        ZASSERT(text.empty() || (static_cast<uint8_t>(text[0]) != 0xFF)) << "Glyph text must be valid UTF-8.";
+        std::memcpy(glyph.bytes, text.data(), static_cast<size_t>(text.size()));
+        return glyph;
+    }
+
+    std::string key(text.data(), static_cast<size_t>(text.size()));
+    auto position = m_indices.find(key);
+    uint32_t index;
+    if (position != m_indices.end()) {
+        index = position->second;
+    } else if (!m_freeIndices.empty()) {
+        index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+        m_texts[index] = key;
+        m_indices.emplace(std::move(key), index);
+    } else {
+        index = static_cast<uint32_t>(m_texts.size());
+        ZASSERT(index < 0xFFFFFF) << "Too many interned glyphs.";
+        m_texts.push_back(key);
+        m_indices.emplace(std::move(key), index);
+    }
+
+    glyph.bytes[0] = static_cast<char>(0xFF);
+    glyph.bytes[1] = static_cast<char>(index & 0xFF);
+    glyph.bytes[2] = static_cast<char>((index >> 8) & 0xFF);
+    glyph.bytes[3] = static_cast<char>((index >> 16) & 0xFF);
+    return glyph;
+}
+
+namespace {
+
+/// Returns index of interned glyph.
+uint32_t getIndex(const Glyph& glyph) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(glyph.bytes[1]))
+         | (static_cast<uint32_t>(static_cast<uint8_t>(glyph.bytes[2])) << 8)
+         | (static_cast<uint32_t>(static_cast<uint8_t>(glyph.bytes[3])) << 16);
+}
+
+} // namespace
+
+gsl::span<const char> GlyphTable::getText(const Glyph& glyph) const {
+    if (!glyph.isInterned()) {
+        auto length = 0;
+        while ((length < static_cast<int>(sizeof(glyph.bytes))) && (glyph.bytes[length] != 0)) {
+            ++length;
+        }
+        return {glyph.bytes, length};
+    }
+
+    auto index = getIndex(glyph);
+    ZASSERT(index < m_texts.size()) << "Invalid glyph index: " << index;
+
+    const auto& text = m_texts[index];
+    return {text.data(), static_cast<gsl::span<const char>::index_type>(text.size())};
+}
+
+void GlyphTable::markUsed(const Glyph& glyph) {
+    if (!glyph.isInterned())
+        return;
+
+    auto index = getIndex(glyph);
+    if (index >= m_used.size()) {
+        m_used.resize(m_texts.size(), false);
+    }
+    m_used[index] = true;
+}
+
+void GlyphTable::compact() {
+    m_used.resize(m_texts.size(), false);
+    for (uint32_t index = 0; index < m_texts.size(); ++index) {
+        auto& text = m_texts[index];
+        if (m_used[index] || text.empty())
+            continue;
+
+        m_indices.erase(text);
+        std::string().swap(text);
+        m_freeIndices.push_back(index);
+    }
+
+    std::fill(m_used.begin(), m_used.end(), false);
+}
+
+void GlyphTable::clear() {
+    m_texts.clear();
+    m_indices.clear();
+    m_freeIndices.clear();
+    m_used.clear();
+}
+
+} // namespace terminal_editor
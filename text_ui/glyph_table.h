@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/span>
+
+namespace terminal_editor {
+
+/// Identifies UTF-8 text of one grapheme drawn on the screen.
+/// Texts of up to 4 bytes (which covers every single code point) are stored inline, zero padded.
+/// Longer texts are interned in a GlyphTable, and bytes[0] is then 0xFF (which never starts valid UTF-8) followed by 24-bit index into the table.
+/// @note Glyph is trivially copyable, and two glyphs from the same GlyphTable are equal if and only if their texts are equal.
+struct Glyph {
+    char bytes[4];
+
+    bool isInterned() const {
+        return static_cast<uint8_t>(bytes[0]) == 0xFF;
+    }
+
+    bool operator==(Glyph other) const {
+        return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+
+    bool operator!=(Glyph other) const {
+        return !(*this == other);
+    }
+};
+
+/// GlyphTable stores texts of glyphs that don't fit inline in the Glyph.
+/// Texts of glyphs that are no longer used are removed by compact(). Glyphs that are still used keep their indices.
+class GlyphTable {
+    std::vector<std::string> m_texts;                   ///< Interned texts, indexed by Glyph index. Removed texts are empty.
+    std::unordered_map<std::string, uint32_t> m_indices; ///< Map from interned text to it's index in m_texts.
+    std::vector<uint32_t> m_freeIndices;                ///< Indices of removed texts, reused by intern().
+    std::vector<bool> m_used;                           ///< Indices marked by markUsed() since the last compact().
+
+public:
+    /// Returns Glyph representing given text. Interns the text if necessary.
+    /// @param text     UTF-8 text. Must not contain zero bytes.
+    Glyph intern(gsl::span<const char> text);
+
+    /// Returns text of given glyph.
+    /// @note For inline glyphs returned span points into the glyph itself, so glyph must outlive it.
+    gsl::span<const char> getText(const Glyph& glyph) const;
+
+    /// Returns number of interned texts.
+    int size() const {
+        return static_cast<int>(m_indices.size());
+    }
+
+    /// Marks given glyph as used, so next compact() keeps it's text.
+    void markUsed(const Glyph& glyph);
+
+    /// Removes texts of all glyphs that were not marked with markUsed(). Glyphs that were not marked become invalid.
+    void compact();
+
+    /// Removes all interned texts. All interned Glyphs become invalid.
+    void clear();
+};
+
+} // namespace terminal_editor
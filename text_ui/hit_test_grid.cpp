@@ -0,0 +1,43 @@
+#include "hit_test_grid.h"
+
+namespace terminal_editor {
+
+HitTestGrid::HitTestGrid(Rect bounds)
+    : m_bounds(bounds)
+    , m_columns((bounds.size.width + cellWidth - 1) / cellWidth) {
+    auto rows = (bounds.size.height + cellHeight - 1) / cellHeight;
+    m_cells.resize(static_cast<size_t>(m_columns * rows));
+}
+
+int HitTestGrid::add(Rect rect) {
+    auto id = static_cast<int>(m_rects.size());
+    rect = rect.intersect(m_bounds);
+    m_rects.push_back(rect);
+    if (rect.isEmpty())
+        return id;
+
+    // Cells are in coordinates relative to bounds.
+    auto first = rect.topLeft - m_bounds.topLeft.asSize();
+    auto last = rect.bottomRight() - m_bounds.topLeft.asSize() - Size{1, 1};
+    for (int row = first.y / cellHeight; row <= last.y / cellHeight; ++row) {
+        for (int column = first.x / cellWidth; column <= last.x / cellWidth; ++column) {
+            m_cells[static_cast<size_t>(row * m_columns + column)].push_back(id);
+        }
+    }
+    return id;
+}
+
+tl::optional<int> HitTestGrid::find(Point point) const {
+    if (!m_bounds.contains(point))
+        return tl::nullopt;
+
+    auto local = point - m_bounds.topLeft.asSize();
+    const auto& cell = m_cells[static_cast<size_t>((local.y / cellHeight) * m_columns + local.x / cellWidth)];
+    for (auto id = cell.rbegin(); id != cell.rend(); ++id) {
+        if (m_rects[static_cast<size_t>(*id)].contains(point))
+            return *id;
+    }
+    return tl::nullopt;
+}
+
+} // namespace terminal_editor
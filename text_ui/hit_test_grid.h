@@ -0,0 +1,37 @@
+#pragma once
+
+#include "geometry.h"
+
+#include <vector>
+
+#include <tl/optional.hpp>
+
+namespace terminal_editor {
+
+/// HitTestGrid finds the topmost of many rectangles that contains a point.
+/// Bounds are divided into cells of cellSize, and every cell lists rectangles that overlap it,
+/// so finding a point checks only rectangles near it, not all of them.
+class HitTestGrid {
+public:
+    static constexpr int cellWidth = 16;
+    static constexpr int cellHeight = 8;
+
+private:
+    Rect m_bounds;                          ///< Only this part of the plane is indexed.
+    int m_columns;                          ///< Number of columns of cells.
+    std::vector<Rect> m_rects;              ///< All rectangles added, clipped to bounds. Index in this vector is rectangle's id.
+    std::vector<std::vector<int>> m_cells;  ///< Ids of rectangles overlapping each cell, in order they were added.
+
+public:
+    /// @param bounds   Part of the plane to index. Parts of rectangles outside of it are never found.
+    explicit HitTestGrid(Rect bounds = Rect());
+
+    /// Adds a rectangle on top of all rectangles added so far.
+    /// @return Id of the rectangle. Ids are consecutive numbers, starting from zero.
+    int add(Rect rect);
+
+    /// Returns id of the last added rectangle that contains given point, or nullopt if there is none.
+    tl::optional<int> find(Point point) const;
+};
+
+} // namespace terminal_editor
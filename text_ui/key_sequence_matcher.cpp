@@ -0,0 +1,96 @@
+#include "key_sequence_matcher.h"
+
+namespace terminal_editor {
+
+KeySequenceMatcher::KeySequenceMatcher(Clock::duration timeout)
+    : m_timeout(timeout)
+    , m_node(0) {
+}
+
+KeySequenceMatcher::Result KeySequenceMatcher::processEvent(const std::string& contextName, const Event& event, const KeyMapIndex& keyMapIndex, Clock::time_point now) {
+    Result result;
+
+    auto keyEvent = std::get_if<KeyPressed>(&event);
+    tl::optional<uint32_t> ctrlCodePoint;
+    if (keyEvent && keyEvent->wasCtrlHeld()) {
+        // Ctrl key strips high 3 bits from character on input.
+        ctrlCodePoint = keyEvent->codePoint | 0x40;
+    }
+
+    if (isPending()) {
+        if (keyEvent) {
+            auto nextNode = keyMapIndex.findSequenceNode(m_contextName, m_node, keyEvent->codePoint, ctrlCodePoint);
+            if (nextNode) {
+                advance(keyMapIndex, *nextNode, *keyEvent, tl::nullopt, now, result);
+                return result;
+            }
+        }
+
+        // Event doesn't continue the sequence, so keys pressed so far are resolved on their own,
+        // and event is processed as if no sequence was pending.
+        abandon(result);
+    }
+
+    if (!keyEvent)
+        return result;
+
+    auto firstNode = keyMapIndex.findSequenceNode(contextName, 0, keyEvent->codePoint, ctrlCodePoint);
+    if (!firstNode)
+        return result;
+
+    m_contextName = contextName;
+    auto keyAction = keyMapIndex.findKeyAction(contextName, keyEvent->codePoint, ctrlCodePoint);
+    advance(keyMapIndex, *firstNode, *keyEvent, keyAction, now, result);
+    return result;
+}
+
+KeySequenceMatcher::Result KeySequenceMatcher::checkTimeout(Clock::time_point now) {
+    Result result;
+    if (isPending() && (now >= m_deadline)) {
+        abandon(result);
+    }
+    return result;
+}
+
+void KeySequenceMatcher::advance(const KeyMapIndex& keyMapIndex, int node, const KeyPressed& keyEvent, tl::optional<ActionId> keyAction, Clock::time_point now, Result& result) {
+    result.consumed = true;
+
+    auto action = keyMapIndex.findSequenceAction(m_contextName, node);
+    if (!keyMapIndex.isSequencePrefix(m_contextName, node)) {
+        result.action = action;
+        reset();
+        return;
+    }
+
+    // Sequence continues, but keys pressed so far can be an ambiguous prefix with an action of their own.
+    m_node = node;
+    m_prefixAction = action ? action : keyAction;
+    m_deadline = now + m_timeout;
+
+    if (!m_pendingKeys.empty())
+        m_pendingKeys += " ";
+    if (keyEvent.wasCtrlHeld())
+        m_pendingKeys += "Ctrl-";
+    m_pendingKeys += keyEvent.getUtf8(true);
+    m_pendingEvents.push_back(keyEvent);
+}
+
+void KeySequenceMatcher::abandon(Result& result) {
+    if (m_prefixAction) {
+        result.abandonedAction = m_prefixAction;
+    } else {
+        // Keys without an action are not lost, they are processed as if no sequence was bound.
+        result.abandonedKeys = std::move(m_pendingEvents);
+    }
+    reset();
+}
+
+void KeySequenceMatcher::reset() {
+    m_contextName.clear();
+    m_node = 0;
+    m_prefixAction = tl::nullopt;
+    m_pendingKeys.clear();
+    m_pendingEvents.clear();
+}
+
+} // namespace terminal_editor
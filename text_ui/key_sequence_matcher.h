@@ -0,0 +1,81 @@
+#pragma once
+
+#include "terminal_io.h"
+#include "editor_config.h"
+
+#include <chrono>
+#include <string>
+#include <tl/optional.hpp>
+#include <vector>
+
+namespace terminal_editor {
+
+/// KeySequenceMatcher follows key sequences (chords like Ctrl-X Ctrl-S) as keys are pressed.
+/// Keys that start or continue a sequence are consumed, and action is returned when the sequence is complete.
+/// Keys pressed so far are resolved on their own (using action of the sequence that ends there, or of the first key) when:
+///   - next key doesn't continue any sequence,
+///   - timeout passes without next key, which is how ambiguous prefixes (that are also bound on their own) are resolved.
+/// If keys pressed so far have no action, they are returned to be processed one by one, as if they weren't part of any sequence.
+/// Each key takes the same number of lookups in KeyMapIndex, no matter how many sequences are bound.
+class KeySequenceMatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Outcome of processing an event.
+    struct Result {
+        bool consumed = false;                  ///< True if event was a key of a sequence. Otherwise event must be processed normally, after abandonedAction.
+        tl::optional<ActionId> abandonedAction; ///< Action of keys pressed so far, if event didn't continue their sequence.
+        std::vector<KeyPressed> abandonedKeys;  ///< Keys pressed so far, if event didn't continue their sequence and they have no action. They must be processed normally, before the event.
+        tl::optional<ActionId> action;          ///< Action of the sequence completed by the event.
+    };
+
+private:
+    Clock::duration m_timeout;              ///< How long to wait for the next key of a sequence.
+    std::string m_contextName;              ///< Key map in which pending sequence was started.
+    int m_node;                             ///< Node of the key sequence trie reached by keys pressed so far. Zero if no sequence is pending.
+    tl::optional<ActionId> m_prefixAction;  ///< Action of keys pressed so far, if they are resolved on their own.
+    Clock::time_point m_deadline;           ///< Time when pending sequence is resolved on its own.
+    std::string m_pendingKeys;              ///< Keys pressed so far, like "Ctrl-X".
+    std::vector<KeyPressed> m_pendingEvents;///< Events of keys pressed so far.
+
+public:
+    /// @param timeout  How long to wait for the next key of a sequence.
+    explicit KeySequenceMatcher(Clock::duration timeout);
+
+    /// Processes input event.
+    /// @param contextName  Name of the key map to use.
+    Result processEvent(const std::string& contextName, const Event& event, const KeyMapIndex& keyMapIndex, Clock::time_point now);
+
+    /// Resolves pending sequence on its own if the timeout has passed.
+    /// @return Result with action or keys of the abandoned sequence. Result is never consumed.
+    Result checkTimeout(Clock::time_point now);
+
+    /// Returns true if keys of a sequence were pressed, and matcher waits for the rest of it.
+    bool isPending() const {
+        return m_node != 0;
+    }
+
+    /// Returns time when pending sequence is resolved on its own.
+    /// @note Must be called only if isPending().
+    Clock::time_point getDeadline() const {
+        return m_deadline;
+    }
+
+    /// Returns keys of pending sequence, like "Ctrl-X", or empty string if no sequence is pending.
+    const std::string& getPendingKeys() const {
+        return m_pendingKeys;
+    }
+
+private:
+    /// Moves to given node of the key sequence trie, or completes the sequence if no longer sequences continue from there.
+    /// @param keyAction    Action of the key, if it is bound on its own. Used only for the first key of a sequence.
+    void advance(const KeyMapIndex& keyMapIndex, int node, const KeyPressed& keyEvent, tl::optional<ActionId> keyAction, Clock::time_point now, Result& result);
+
+    /// Resolves keys pressed so far on their own, and forgets pending sequence.
+    void abandon(Result& result);
+
+    /// Forgets pending sequence.
+    void reset();
+};
+
+} // namespace terminal_editor
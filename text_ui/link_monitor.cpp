@@ -0,0 +1,36 @@
+#include "link_monitor.h"
+
+namespace terminal_editor {
+
+namespace {
+
+/// Weight of the newest sample in moving averages.
+constexpr double averageWeight = 0.25;
+
+double toSeconds(LinkMonitor::Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+void LinkMonitor::frameWritten(size_t bytes, Clock::duration duration) {
+    auto seconds = toSeconds(duration);
+    m_writeTime += averageWeight * (seconds - m_writeTime);
+
+    if (duration >= blockingWriteTime) {
+        auto throughput = static_cast<double>(bytes) / seconds;
+        if (m_throughput == 0.0) {
+            m_throughput = throughput;
+        } else {
+            m_throughput += averageWeight * (throughput - m_throughput);
+        }
+    }
+
+    if (m_saturated) {
+        m_saturated = m_writeTime >= toSeconds(unsaturatedWriteTime);
+    } else {
+        m_saturated = m_writeTime >= toSeconds(saturatedWriteTime);
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace terminal_editor {
+
+/// LinkMonitor measures how fast the terminal accepts output, and detects when the link to it is saturated.
+/// Writes that return quickly only fill kernel buffers, so they say nothing about the link. Throughput is measured only on writes that blocked.
+/// Link becomes saturated when average time of writing a frame grows above saturatedWriteTime,
+/// and stops being saturated when it drops below unsaturatedWriteTime, so the mode doesn't flicker.
+class LinkMonitor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::duration blockingWriteTime = std::chrono::milliseconds(2);      ///< Writes taking longer than this have blocked.
+    static constexpr Clock::duration saturatedWriteTime = std::chrono::milliseconds(50);    ///< Average write time at which link becomes saturated.
+    static constexpr Clock::duration unsaturatedWriteTime = std::chrono::milliseconds(10);  ///< Average write time at which link stops being saturated.
+
+private:
+    double m_throughput;    ///< Bytes per second, averaged over writes that blocked. Zero if no write has blocked yet.
+    double m_writeTime;     ///< Average time of writing a frame, in seconds.
+    bool m_saturated;       ///< True if terminal doesn't keep up with output.
+
+public:
+    LinkMonitor()
+        : m_throughput(0.0)
+        , m_writeTime(0.0)
+        , m_saturated(false) {
+    }
+
+    /// Must be called after each frame is written.
+    /// @param bytes        Size of the frame.
+    /// @param duration     Time that writing took, until the terminal accepted all bytes.
+    void frameWritten(size_t bytes, Clock::duration duration);
+
+    /// Returns measured throughput of the link in bytes per second, or zero if it wasn't measured yet.
+    double getThroughput() const {
+        return m_throughput;
+    }
+
+    /// Returns true if terminal doesn't keep up with output, so frames should be made smaller and less frequent.
+    bool isSaturated() const {
+        return m_saturated;
+    }
+};
+
+} // namespace terminal_editor
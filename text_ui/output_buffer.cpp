@@ -0,0 +1,80 @@
+#include "output_buffer.h"
+
+#include "zerrors.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace terminal_editor {
+
+void OutputBuffer::appendNumber(int number) {
+    char digits[16];
+    int length = 0;
+
+    // Use unsigned arithmetic, so that the most negative number also works.
+    auto value = static_cast<unsigned int>(number);
+    if (number < 0) {
+        append('-');
+        value = 0u - value;
+    }
+
+    do {
+        digits[length++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (length > 0) {
+        append(digits[--length]);
+    }
+}
+
+void writeToTerminal(gsl::span<const char> data) {
+    std::fflush(stdout);
+
+#ifdef WIN32
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (hOut == INVALID_HANDLE_VALUE) {
+        ZTHROW() << "Could not get console output handle: " << GetLastError();
+    }
+
+    while (!data.empty()) {
+        DWORD numberOfCharsWritten;
+        if (!WriteConsoleA(hOut, data.data(), static_cast<DWORD>(data.size()), &numberOfCharsWritten, NULL)) {
+            ZTHROW() << "Error while writing to console: " << GetLastError();
+        }
+        data = data.subspan(numberOfCharsWritten);
+    }
+#else
+    int stdout_fd = ::fileno(stdout);
+
+    while (!data.empty()) {
+        auto written = ::write(stdout_fd, data.data(), static_cast<size_t>(data.size()));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            // EWOULDBLOCK is the same as EAGAIN on all relevant platforms.
+            if (errno == EAGAIN) {
+                ::pollfd pollFd{stdout_fd, POLLOUT, 0};
+                if ((::poll(&pollFd, 1, -1) < 0) && (errno != EINTR))
+                    throw std::system_error(errno, std::generic_category(), "poll");
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "write");
+        }
+
+        data = data.subspan(written);
+    }
+#endif
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <gsl/span>
+
+namespace terminal_editor {
+
+/// Growable byte buffer used to build output for the terminal.
+/// Memory is kept between uses, so once it has grown to the size of a typical frame, building output doesn't allocate.
+class OutputBuffer {
+    std::string m_data;
+
+public:
+    /// Removes all bytes from the buffer. Keeps allocated memory.
+    void clear() {
+        m_data.clear();
+    }
+
+    bool empty() const {
+        return m_data.empty();
+    }
+
+    size_t size() const {
+        return m_data.size();
+    }
+
+    const char* data() const {
+        return m_data.data();
+    }
+
+    /// Returns contents of the buffer as a string. Used for debugging.
+    const std::string& str() const {
+        return m_data;
+    }
+
+    void append(char byte) {
+        m_data.push_back(byte);
+    }
+
+    void append(gsl::span<const char> bytes) {
+        m_data.append(bytes.data(), static_cast<size_t>(bytes.size()));
+    }
+
+    /// @param text     Zero terminated string.
+    void append(const char* text) {
+        m_data.append(text);
+    }
+
+    /// Appends decimal representation of given number.
+    void appendNumber(int number);
+
+    /// Appends CSI sequence with one numeric parameter: ESC [ param finalByte
+    void appendCsi(int param, char finalByte) {
+        append("\x1B[");
+        appendNumber(param);
+        append(finalByte);
+    }
+
+    /// Appends CSI sequence with two numeric parameters: ESC [ param0 ; param1 finalByte
+    void appendCsi(int param0, int param1, char finalByte) {
+        append("\x1B[");
+        appendNumber(param0);
+        append(';');
+        appendNumber(param1);
+        append(finalByte);
+    }
+};
+
+/// Writes given data to the terminal.
+/// Data is written with one system call, unless terminal accepts only part of it.
+/// Partial writes and interrupted writes are retried. If output is non-blocking, waits until the terminal can accept more data.
+/// @note Data buffered in stdout is flushed first, so the order of output is preserved.
+void writeToTerminal(gsl::span<const char> data);
+
+} // namespace terminal_editor
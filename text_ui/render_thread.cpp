@@ -0,0 +1,90 @@
+#include "render_thread.h"
+
+#include <utility>
+
+namespace terminal_editor {
+
+RenderThread::RenderThread(ScreenBuffer& screenBuffer)
+    : m_screenBuffer(screenBuffer)
+    , m_rendering(false)
+    , m_stop(false)
+    , m_thread(&RenderThread::loop, this) {
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+bool RenderThread::reclaimPendingFrame() {
+    Frame frame;
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        std::swap(m_pendingFrame, frame);
+    }
+    // Reclaimed frame is destroyed here, outside of the mutex.
+    return static_cast<bool>(frame);
+}
+
+void RenderThread::submitFrame(Frame frame) {
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        checkError();
+        std::swap(m_pendingFrame, frame);
+    }
+    m_cv.notify_all();
+    // Replaced frame is destroyed here, outside of the mutex.
+}
+
+void RenderThread::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_cv.wait(lock, [this]() { return (!m_pendingFrame && !m_rendering) || m_error; });
+    checkError();
+}
+
+void RenderThread::loop() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+        m_cv.wait(lock, [this]() { return m_pendingFrame || m_stop; });
+
+        // Pending frame is rendered even when stopping, so the terminal shows the last frame.
+        if (!m_pendingFrame)
+            break;
+
+        auto frame = std::move(m_pendingFrame);
+        m_pendingFrame = nullptr;
+        m_rendering = true;
+
+        lock.unlock();
+        try {
+            frame(m_screenBuffer);
+            m_screenBuffer.present();
+        }
+        catch (...) {
+            lock.lock();
+            m_error = std::current_exception();
+            m_rendering = false;
+            m_cv.notify_all();
+            break;
+        }
+        // Frame is destroyed outside of the mutex, because it can own a lot of data.
+        frame = nullptr;
+        lock.lock();
+
+        m_rendering = false;
+        m_cv.notify_all();
+    }
+}
+
+void RenderThread::checkError() {
+    // Render thread has exited, so error is never cleared.
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "screen_buffer.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace terminal_editor {
+
+/// RenderThread composes and presents frames on a separate thread, so slow drawing never delays input handling.
+/// Model thread makes a frame from immutable snapshots of it's state (see WindowSnapshot), and submits it.
+/// Only the latest frame is kept: if render thread is busy, older frame waiting to be rendered is replaced.
+/// @note While render thread is running, ScreenBuffer can be used by other threads only after waitUntilIdle().
+class RenderThread {
+public:
+    /// Frame draws itself on the screen buffer. It must own all data it uses.
+    using Frame = std::function<void(ScreenBuffer& screenBuffer)>;
+
+private:
+    ScreenBuffer& m_screenBuffer;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;   ///< Signalled when frame is submitted, when rendering ends, and on stop.
+    Frame m_pendingFrame;           ///< Frame waiting to be rendered. Empty if there is none.
+    bool m_rendering;               ///< True while render thread draws and presents a frame.
+    bool m_stop;                    ///< Tells render thread to exit.
+    std::exception_ptr m_error;     ///< Error that happened on the render thread. It is rethrown by submitFrame() and waitUntilIdle().
+    std::thread m_thread;           ///< This must be last to make sure thread starts after all members are initialized.
+
+public:
+    /// @param screenBuffer     Screen buffer that frames are drawn on, and presented. It must outlive the RenderThread.
+    explicit RenderThread(ScreenBuffer& screenBuffer);
+
+    /// Renders frame that is waiting, and stops the render thread.
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    /// Takes back the frame that is waiting to be rendered, if the render thread didn't start rendering it yet.
+    /// Frames that redraw only part of the screen use it to learn that their region must be included in the next frame.
+    /// @return True if frame was reclaimed.
+    bool reclaimPendingFrame();
+
+    /// Passes frame to the render thread, replacing frame that waits to be rendered. Never waits for rendering.
+    void submitFrame(Frame frame);
+
+    /// Waits until all submitted frames are rendered and presented.
+    /// After that ScreenBuffer can be used by calling thread, until next submitFrame().
+    void waitUntilIdle();
+
+private:
+    /// Thread function.
+    void loop();
+
+    /// Rethrows error from the render thread, if there was one.
+    /// @note Must be called under mutex.
+    void checkError();
+};
+
+} // namespace terminal_editor
@@ -2,10 +2,15 @@
 
 #include "zerrors.h"
 #include "screen_functions.h"
+#include "terminal_encoder.h"
+#include "terminal_writer.h"
+#include "worker_pool.h"
 #include "terminal_io.h"
-#include "text_buffer.h"
+#include "shaped_text_cache.h"
 #include "zlogging.h"
 
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 
 #ifdef WIN32
@@ -23,29 +28,94 @@ namespace terminal_editor {
 #define _u8(x) u8##x
 #endif
 
+namespace {
+
+/// Finalizer of SplitMix64.
+uint64_t mixBits(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+/// Returns well mixed hash of a Character.
+/// It is used to compute row hashes, which are weighted sums of character hashes.
+uint64_t hashCharacter(const ScreenBuffer::Character& character) {
+    uint32_t glyph;
+    std::memcpy(&glyph, character.glyph.bytes, sizeof(glyph));
+
+    return mixBits(mixBits(glyph) ^ character.getPackedWord());
+}
+
+} // namespace
+
 void ScreenBuffer::resize(int w, int h) {
     size.width = w;
     size.height = h;
 
-    Character emptyCharacter{" ", 1, {Color::Yellow, Color::Red, Style::Normal}};
+    // Nothing refers to interned glyphs any more.
+    glyphTable.clear();
+
+    Character emptyCharacter{glyphTable.intern(" "), {Color::Yellow, Color::Red, Style::Normal}, 1};
 
-    characters.resize(0);
-    previousCharacters.resize(0);
-    characters.resize(size.width * size.height, emptyCharacter);
-    previousCharacters.resize(size.width * size.height, emptyCharacter);
+    characters.assign(size.width * size.height, emptyCharacter);
+    previousCharacters.assign(size.width * size.height, emptyCharacter);
+
+    // Weights are consecutive powers of an odd constant, so they are all different and odd.
+    hashWeights.resize(size.width);
+    hashWeightsSum = 0;
+    uint64_t weight = 1;
+    for (auto& hashWeight : hashWeights) {
+        hashWeight = weight;
+        hashWeightsSum += weight;
+        weight *= 0x100000001B3ull;
+    }
+
+    rowHashes.assign(size.height, hashCharacter(emptyCharacter) * hashWeightsSum);
+    previousRowHashes = rowHashes;
+    damage.assign(size.height, RowDamage{0, size.width});
 
     fullRepaintNeeded = true;
+    undoSpans.clear();
+    undoCharacters.clear();
+    undoNeedsFullRepaint = true;
+}
+
+void ScreenBuffer::waitForOutput() {
+    if (terminalWriter) {
+        terminalWriter->waitUntilWritten();
+    }
+}
+
+bool ScreenBuffer::isOutputBusy() {
+    return terminalWriter && terminalWriter->isBusy();
+}
+
+bool ScreenBuffer::isLinkSaturated() {
+    if (terminalWriter)
+        return terminalWriter->getLinkMonitor().isSaturated();
+    return linkMonitor.isSaturated();
+}
+
+double ScreenBuffer::getLinkThroughput() {
+    if (terminalWriter)
+        return terminalWriter->getLinkMonitor().getThroughput();
+    return linkMonitor.getThroughput();
 }
 
 void ScreenBuffer::clear(Color bgColor) {
-    Character emptyCharacter{" ", 1, {Color::White, bgColor, Style::Normal}};
+    Character emptyCharacter{glyphTable.intern(" "), {Color::White, bgColor, Style::Normal}, 1};
 
-    characters.resize(0);
-    characters.resize(size.width * size.height, emptyCharacter);
+    std::fill(characters.begin(), characters.end(), emptyCharacter);
+    std::fill(rowHashes.begin(), rowHashes.end(), hashCharacter(emptyCharacter) * hashWeightsSum);
+    std::fill(damage.begin(), damage.end(), RowDamage{0, size.width});
+    cursor = tl::nullopt;
 }
 
 void ScreenBuffer::fillRect(Rect rect, Color bgColor) {
-    Character emptyCharacter{" ", 1, {Color::White, bgColor, Style::Normal}};
+    Character emptyCharacter{glyphTable.intern(" "), {Color::White, bgColor, Style::Normal}, 1};
 
     rect = rect.intersect(getSize());
     if (rect.isEmpty())
@@ -58,15 +128,63 @@ void ScreenBuffer::fillRect(Rect rect, Color bgColor) {
 
     for (int y = startY; y < endY; ++y) {
         for (int x = startX; x < endX; ++x) {
-            characters[y * size.width + x] = emptyCharacter;
+            setCharacter(characters, rowHashes, x, y, emptyCharacter);
+        }
+        damageRow(y, startX, endX);
+    }
+}
+
+void ScreenBuffer::invalidateRect(Rect rect) {
+    presentedCursor = tl::nullopt;
+
+    auto invalid = invalidCharacter();
+
+    rect = rect.intersect(getSize());
+    if (rect.isEmpty())
+        return;
+
+    for (int y = rect.topLeft.y; y < rect.bottomRight().y; ++y) {
+        auto startX = rect.topLeft.x;
+        auto endX = rect.bottomRight().x;
+
+        // Terminal erases whole wide characters when any of their cells is overwritten, so we extend the range to whole graphemes.
+        while ((startX > 0) && (previousCharacters[y * size.width + startX].getWidth() == 0)) {
+            --startX;
+        }
+        while ((endX < size.width) && (previousCharacters[y * size.width + endX].getWidth() == 0)) {
+            ++endX;
+        }
+
+        for (int x = startX; x < endX; ++x) {
+            setCharacter(previousCharacters, previousRowHashes, x, y, invalid);
         }
+        damageRow(y, startX, endX);
     }
 }
 
+void ScreenBuffer::setCharacter(std::vector<Character>& buffer, std::vector<uint64_t>& bufferHashes, int x, int y, Character character) {
+    auto& oldCharacter = buffer[y * size.width + x];
+    bufferHashes[y] += (hashCharacter(character) - hashCharacter(oldCharacter)) * hashWeights[x];
+    oldCharacter = character;
+}
+
+void ScreenBuffer::compactGlyphTable() {
+    if (glyphTable.size() < glyphCompactionSize)
+        return;
+
+    for (const auto& buffer : {&characters, &previousCharacters, &undoCharacters}) {
+        for (const auto& character : *buffer) {
+            glyphTable.markUsed(character.glyph);
+        }
+    }
+    glyphTable.compact();
+
+    glyphCompactionSize = std::max(minGlyphCompactionSize, 2 * glyphTable.size());
+}
+
 void ScreenBuffer::print(int x, int y, const std::string& text, Attributes attributes) {
-    auto codePointInfos = parseLine(text);
-    auto graphemes = renderLine(codePointInfos);
-    print(x, y, graphemes, attributes);
+    auto shapedText = shapeText(text);
+    print(x, y, shapedText->graphemes, attributes);
 }
 
 void ScreenBuffer::print(int x, int y, gsl::span<const Grapheme> graphemes, Attributes attributes) {
@@ -74,48 +192,73 @@ void ScreenBuffer::print(int x, int y, gsl::span<const Grapheme> graphemes, Attr
     ZASSERT(y >= 0);
     ZASSERT(y < size.height);
 
+    Character emptyCharacter{glyphTable.intern(""), attributes, 0};
+    auto vacuum = vacuumCharacter();
+
     int curX = x;
+    int damageEnd = x;
     for (const auto& grapheme : graphemes) {
         ZASSERT(curX + grapheme.width <= size.width);
+        ZASSERT(grapheme.width <= Character::maxWidth) << "Grapheme is too wide: " << grapheme.width;
 
-        Character character{grapheme.rendered, grapheme.width, attributes};
-        Character emptyCharacter{"", 0, attributes};
+        Character character{glyphTable.intern(grapheme.rendered), attributes, grapheme.width};
 
         // Find end of graphemes that are being overwritten.
         int endX = curX;
         for (int i = 0; i < grapheme.width; ++i) {
-            endX += characters[y * size.width + curX + i].width;
+            endX += characters[y * size.width + curX + i].getWidth();
         }
 
         // Insert new grapheme.
-        characters[y * size.width + curX] = character;
+        setCharacter(characters, rowHashes, curX, y, character);
         for (int i = 1; i < grapheme.width; ++i) {
-            characters[y * size.width + curX + i] = emptyCharacter;
+            setCharacter(characters, rowHashes, curX + i, y, emptyCharacter);
         }
 
         curX += grapheme.width;
 
         // Fill vacum left by overwriting existing graphemes.
-        Character vacumCharacter{" ", 1, {Color::Cyan, Color::Yellow, Style::Normal}};
         for (int i = curX; i < endX; ++i) {
-            characters[y * size.width + i] = vacumCharacter;
+            setCharacter(characters, rowHashes, i, y, vacuum);
         }
+
+        damageEnd = std::max(damageEnd, std::max(curX, endX));
+    }
+
+    if (damageEnd > x) {
+        damageRow(y, x, damageEnd);
     }
 }
 
-int setStyle(std::ostream& os, int currentStyleHash, Attributes attributes) {
-    int fgColorCode = static_cast<int>(attributes.fgColor);
-    int bgColorCode = static_cast<int>(attributes.bgColor) + 10;
-    int styleCode = static_cast<int>(attributes.style);
+void ScreenBuffer::fillRun(int x, int y, int length, const Grapheme& grapheme, Attributes attributes) {
+    if (length <= 0)
+        return;
 
-    int styleHash = (fgColorCode << 16) + (bgColorCode << 8) + styleCode;
-    if (styleHash == currentStyleHash)
-        return styleHash;
+    ZASSERT(x >= 0);
+    ZASSERT(y >= 0);
+    ZASSERT(y < size.height);
+    ZASSERT(x + length <= size.width);
+    ZASSERT(grapheme.width == 1) << "Only graphemes of width 1 can fill runs: " << grapheme.width;
 
-    // fprintf(stdout, "\x1B[%d;%d;%dm", fgColorCode, bgColorCode, styleCode);
-    os << "\x1B[" << fgColorCode << ";" << bgColorCode << ";" << styleCode << "m";
+    Character character{glyphTable.intern(grapheme.rendered), attributes, 1};
 
-    return styleHash;
+    // Find end of graphemes that are being overwritten. Any of them can extend past the run.
+    auto endX = x + length;
+    for (int i = x; i < x + length; ++i) {
+        endX = std::max(endX, i + characters[y * size.width + i].getWidth());
+    }
+
+    for (int i = x; i < x + length; ++i) {
+        setCharacter(characters, rowHashes, i, y, character);
+    }
+
+    // Fill vacum left by overwriting existing graphemes.
+    auto vacuum = vacuumCharacter();
+    for (int i = x + length; i < endX; ++i) {
+        setCharacter(characters, rowHashes, i, y, vacuum);
+    }
+
+    damageRow(y, x, endX);
 }
 
 // There are two implementations for Windows:
@@ -167,7 +310,7 @@ std::unordered_map<Color, WORD> bgColors = {
 };
 
 WORD attributesToWinAttributes(Attributes attributes) {
-    WORD winAttributes = fgColors.at(attributes.fgColor) | bgColors.at(attributes.bgColor) | (attributes.style == Style::Bold ? COMMON_LVB_UNDERSCORE : 0);
+    WORD winAttributes = fgColors.at(attributes.fgColor) | bgColors.at(attributes.bgColor) | (hasStyle(attributes.style, Style::Underline) ? COMMON_LVB_UNDERSCORE : 0);
     return winAttributes;
 }
 
@@ -192,29 +335,30 @@ tl::optional<uint16_t> utf32ToUtf16(const CodePointInfo& codePointInfo) {
     return tl::nullopt;
 }
 
-std::vector<CHAR_INFO> buildWindowsConsoleBuffer(Size size, const std::vector<ScreenBuffer::Character>& characters) {
+std::vector<CHAR_INFO> buildWindowsConsoleBuffer(Size size, const GlyphTable& glyphTable, const std::vector<ScreenBuffer::Character>& characters) {
     std::vector<CHAR_INFO> screen(size.width * size.height);
 
     for (int y = 0; y < size.height; ++y) {
         for (int x = 0; x < size.width; ++x) {
             const auto& character = characters[y * size.width + x];
+            auto text = glyphTable.getText(character.glyph);
 
-            if (character.text.size() == 1) {
+            if (text.size() == 1) {
                 CHAR_INFO& charInfo = screen[y * size.width + x];
-                charInfo.Char.UnicodeChar = character.text[0];
-                charInfo.Attributes = attributesToWinAttributes(character.attributes);
+                charInfo.Char.UnicodeChar = text[0];
+                charInfo.Attributes = attributesToWinAttributes(character.getAttributes());
                 continue;
             }
 
             // Character can be either a single character, or a replacement string, so this simple code below works more or less.
-            auto codePointInfos = parseLine(character.text);
+            auto codePointInfos = parseLine(text);
             for (int offset = 0; offset < codePointInfos.size(); ++offset) {
                 const CodePointInfo& codePointInfo = codePointInfos[offset];
                 auto utf16 = utf32ToUtf16(codePointInfo);
                 CHAR_INFO& charInfo = screen[y * size.width + x + offset];
                 if (utf16) {
                     charInfo.Char.UnicodeChar = *utf16;
-                    charInfo.Attributes = attributesToWinAttributes(character.attributes);
+                    charInfo.Attributes = attributesToWinAttributes(character.getAttributes());
                 } else {
                     charInfo.Char.UnicodeChar = static_cast<WORD>('@');
                     charInfo.Attributes = fgColors.at(Color::Cyan) | bgColors.at(Color::Bright_Magenta);
@@ -230,7 +374,7 @@ void ScreenBuffer::present() {
     if ( (size.width == 0) || (size.height == 0) )
         return;
 
-    auto screenBuffer = buildWindowsConsoleBuffer(size, characters);
+    auto screenBuffer = buildWindowsConsoleBuffer(size, glyphTable, characters);
 
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hOut == INVALID_HANDLE_VALUE) {
@@ -244,8 +388,12 @@ void ScreenBuffer::present() {
         ZTHROW() << "Failed writing to console: " << GetLastError();
     }
 
+    frameArena.reset();
     fullRepaintNeeded = false;
     previousCharacters = characters;
+    previousRowHashes = rowHashes;
+    std::fill(damage.begin(), damage.end(), RowDamage{size.width, 0});
+    compactGlyphTable();
 }
 
 #endif
@@ -282,40 +430,29 @@ void cursor_goto(HANDLE hOut, int x, int y) {
 
 #if !defined(WIN32) || (USE_WIN32_CONSOLE == 0) || (USE_WIN32_CONSOLE == 1)
 
-int measureText(EventQueue& eventQueue, gsl::span<uint32_t> codePoints) {
-    auto makeRequest = [codePoints]() {
-#ifdef WIN32
-        HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-        if (hOut == INVALID_HANDLE_VALUE) {
-            ZTHROW() << "Could not get console output handle: " << GetLastError();
-        }
-#endif
+int measureText(EventQueue& eventQueue, ScreenBuffer& screenBuffer, gsl::span<uint32_t> codePoints) {
+    // Cursor is moved by the request, so frames must not be written at the same time.
+    screenBuffer.waitForOutput();
 
-        std::stringstream ss;
+    auto makeRequest = [codePoints]() {
+        OutputBuffer output;
 
-        cursor_goto(ss, 0, 0);
+        cursor_goto(output, 0, 0);
 
         // Add two dotted circles to be able to measure combining characters better.
-        appendCodePoint(ss, 0x25CC);
-        appendCodePoint(ss, 0x25CC);
+        std::string text;
+        appendCodePoint(text, 0x25CC);
+        appendCodePoint(text, 0x25CC);
 
         for (auto codePoint : codePoints) {
-            appendCodePoint(ss, codePoint);
+            appendCodePoint(text, codePoint);
         }
 
-        ss << "X"; // For debugging.
-        ss << "\x1b[6n"; // Get cursor position. Expected response: ^[<Line>;<Column>R (both Line and Column might be missing, which is equvalent to zero).
+        output.append(text);
+        output.append("X"); // For debugging.
+        output.append("\x1b[6n"); // Get cursor position. Expected response: ^[<Line>;<Column>R (both Line and Column might be missing, which is equvalent to zero).
 
-        auto str = ss.str();
-#ifdef WIN32
-        DWORD numberOfCharsWritten;
-        if (!WriteConsoleA(hOut, str.c_str(), static_cast<DWORD>(str.size()), &numberOfCharsWritten, NULL)) {
-            ZTHROW() << "Error while writing to console: " << GetLastError();
-        }
-#else
-        fputs(str.c_str(), stdout);
-        std::fflush(stdout);
-#endif
+        writeToTerminal(output.str());
     };
 
     auto processEvent = [](Event e) -> EventQueue::EventResult {
@@ -337,31 +474,36 @@ int measureText(EventQueue& eventQueue, gsl::span<uint32_t> codePoints) {
 
     auto acceptedEvent = eventQueue.requestAndResponse(makeRequest, processEvent, std::chrono::seconds(1));
     if (!acceptedEvent) {
+        // We don't know how much of the text was drawn.
+        screenBuffer.setFullRepaintNeeded();
         ZTHROW() << "measureText(): Timeout.";
     }
 
     auto escEvent = std::get<Esc>(*acceptedEvent);
 
     if (!escEvent.csiIntermediateBytes.empty()) {
+        screenBuffer.setFullRepaintNeeded();
         ZTHROW() << "measureText(): unexpected intermediate bytes: " << escEvent.csiIntermediateBytes;
     }
 
-    std::vector<std::string> params;
-    if (!escEvent.csiParameterBytes.empty()) {
-        params = splitString(escEvent.csiParameterBytes, ';');
-    }
-    if (params.size() != 2) {
+    auto params = parseCsiParams(escEvent.csiParameterBytes);
+    if (!params || (params->privateMarker != 0) || (params->count != 2)) {
+        screenBuffer.setFullRepaintNeeded();
         ZTHROW() << "measureText(): invalid response parameters: " << escEvent.csiParameterBytes;
     }
 
-    // Returned line and colums are 1 based, so we adjust for it here.
-    int line = params[0].empty() ? 0 : static_cast<int>(std::strtol(params[0].c_str(), nullptr, 10)) - 1;
-    int column = params[1].empty() ? 0 : static_cast<int>(std::strtol(params[1].c_str(), nullptr, 10)) - 1;
+    // Returned line and colums are 1 based, so we adjust for it here. Empty parameters default to 1.
+    int line = std::max(params->values[0], 1) - 1;
+    int column = std::max(params->values[1], 1) - 1;
 
     if (line != 0) {
+        screenBuffer.setFullRepaintNeeded();
         ZTHROW() << "measureText(): text wrapped to another line: " << line;
     }
 
+    // Text occupies all cells from the left edge of the first line up to the cursor.
+    screenBuffer.invalidateRect(Rect{Point{0, 0}, Size{column, 1}});
+
     auto width = column - 3;
     if (width < 0) {
         ZTHROW() << "measureText(): text has negative length: " << width;
@@ -370,105 +512,471 @@ int measureText(EventQueue& eventQueue, gsl::span<uint32_t> codePoints) {
     return width;
 }
 
+bool querySynchronizedOutput(EventQueue& eventQueue) {
+    auto makeRequest = []() {
+        OutputBuffer output;
+        output.append("\x1b[?2026$p"); // DECRQM. Expected response: ^[?2026;<Status>$y
+        output.append("\x1b[c");       // Primary Device Attributes. Expected response: ^[?<Attributes>c
+        writeToTerminal(output.str());
+    };
+
+    // Status of the mode: 0 - not recognized, 1 - set, 2 - reset, 3 - permanently set, 4 - permanently reset.
+    int modeStatus = 0;
+    auto processEvent = [&modeStatus](Event e) -> EventQueue::EventResult {
+        auto escEvent = std::get_if<Esc>(&e);
+        if (!escEvent || !escEvent->isCSI()) {
+            return EventQueue::EventResult(false, false);
+        }
+
+        if ((escEvent->csiFinalByte == 'y') && (escEvent->csiIntermediateBytes == "$")) {
+            auto params = parseCsiParams(escEvent->csiParameterBytes);
+            if (params && (params->privateMarker == '?') && (params->count == 2) && (params->values[0] == 2026)) {
+                modeStatus = params->values[1];
+                return EventQueue::EventResult(true, false);
+            }
+        }
+
+        // Response to DA1 comes after response to DECRQM, if there was any.
+        if ((escEvent->csiFinalByte == 'c') && !escEvent->csiParameterBytes.empty() && (escEvent->csiParameterBytes[0] == '?')) {
+            return EventQueue::EventResult(true, true);
+        }
+
+        return EventQueue::EventResult(false, false);
+    };
+
+    auto acceptedEvent = eventQueue.requestAndResponse(makeRequest, processEvent, std::chrono::seconds(1));
+    if (!acceptedEvent) {
+        LOG() << "querySynchronizedOutput(): Timeout.";
+        return false;
+    }
+
+    return (modeStatus >= 1) && (modeStatus <= 3);
+}
+
+#endif
+
+#if defined(WIN32) && (USE_WIN32_CONSOLE == 1)
+
 void ScreenBuffer::present() {
-#ifdef WIN32
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hOut == INVALID_HANDLE_VALUE) {
         ZTHROW() << "Could not get console output handle: " << GetLastError();
     }
-#else
-    int hOut = 0; // Not used.
-#endif
 
-#if defined(WIN32) && (USE_WIN32_CONSOLE == 1)
-    auto ss = hOut;
-#else
-    std::stringstream ss;
+    int currentStyleHash = 0;
+    for (int y = 0; y < size.height; ++y) {
+        for (int x = 0; x < size.width; ++x) {
+            const auto& character = characters[y * size.width + x];
+            if (character.getWidth() == 0)
+                continue;
+
+            if (!fullRepaintNeeded && (previousCharacters[y * size.width + x] == character))
+                continue;
+
+            cursor_goto(hOut, x, y);
+            currentStyleHash = setStyle(hOut, currentStyleHash, character.getAttributes());
+
+            auto text = glyphTable.getText(character.glyph);
+            DWORD numberOfCharsWritten;
+            if (!WriteConsoleA(hOut, text.data(), static_cast<DWORD>(text.size()), &numberOfCharsWritten, NULL)) {
+                ZTHROW() << "Error while writing to console: " << GetLastError();
+            }
+        }
+    }
+
+    frameArena.reset();
+    fullRepaintNeeded = false;
+    previousCharacters = characters;
+    previousRowHashes = rowHashes;
+    std::fill(damage.begin(), damage.end(), RowDamage{size.width, 0});
+    compactGlyphTable();
+}
+
 #endif
 
-    bool debugPrint = false;
+#if !defined(WIN32) || (USE_WIN32_CONSOLE == 0)
 
-    auto flushToScreen = [hOut, &ss, &debugPrint]() {
-        auto str = ss.str();
-        if (debugPrint) {
-            LOG() << "Drawing: " << str;
+void ScreenBuffer::scrollMovedRows(TerminalEncoder& encoder) {
+    // Each accepted shift reduces number of rows that differ from the previous frame, so this loop ends.
+    while (true) {
+        // Best shift found: rows [bestBegin, bestEnd) show rows of the previous frame moved by bestShift (positive values move up).
+        int bestBegin = 0;
+        int bestEnd = 0;
+        int bestShift = 0;
+        int bestGain = 0;
+
+        for (int shift = 1 - size.height; shift < size.height; ++shift) {
+            if (shift == 0)
+                continue;
+
+            auto firstRow = std::max(0, -shift);
+            auto lastRow = std::min(size.height, size.height - shift);
+            for (int begin = firstRow; begin < lastRow; ) {
+                if (rowHashes[begin] != previousRowHashes[begin + shift]) {
+                    ++begin;
+                    continue;
+                }
+
+                // Rows that match after the shift, but not without it, won't have to be repainted.
+                int saved = 0;
+                auto end = begin;
+                while ((end < lastRow) && (rowHashes[end] == previousRowHashes[end + shift])) {
+                    if (rowHashes[end] != previousRowHashes[end])
+                        ++saved;
+                    ++end;
+                }
+
+                // Rows exposed by scrolling have to be repainted, even if they were matching before.
+                auto exposedBegin = (shift > 0) ? end : begin + shift;
+                auto exposedEnd = (shift > 0) ? end + shift : begin;
+                int lost = 0;
+                for (int y = exposedBegin; y < exposedEnd; ++y) {
+                    if (rowHashes[y] == previousRowHashes[y])
+                        ++lost;
+                }
+
+                if (saved - lost > bestGain) {
+                    bestBegin = begin;
+                    bestEnd = end;
+                    bestShift = shift;
+                    bestGain = saved - lost;
+                }
+
+                begin = end;
+            }
         }
-#ifdef WIN32
-        DWORD numberOfCharsWritten;
-        if (!WriteConsoleA(hOut, str.c_str(), static_cast<DWORD>(str.size()), &numberOfCharsWritten, NULL)) {
-            ZTHROW() << "Error while writing to console: " << GetLastError();
+
+        if (bestGain <= 0)
+            return;
+
+        // Hashes can collide, so make sure rows really match.
+        for (int y = bestBegin; y < bestEnd; ++y) {
+            auto row = characters.begin() + y * size.width;
+            auto previousRow = previousCharacters.begin() + (y + bestShift) * size.width;
+            if (!std::equal(row, row + size.width, previousRow))
+                return;
         }
-#else
-        fputs(str.c_str(), stdout);
-        std::fflush(stdout);
-#endif
-        ss.str(std::string());
-    };
 
-    // Clear screen.
-    if (debugPrint) {
-        ss << "\x1b[2J";
-        flushToScreen();
+        // Scroll the region on the terminal, and shift previousCharacters the same way.
+        auto top = (bestShift > 0) ? bestBegin : bestBegin + bestShift;
+        auto bottom = (bestShift > 0) ? bestEnd + bestShift : bestEnd;
+        encoder.scrollRows(top, bottom - 1, bestShift);
+        undoNeedsFullRepaint = true;
+
+        if (bestShift > 0) {
+            std::copy(previousCharacters.begin() + (top + bestShift) * size.width, previousCharacters.begin() + bottom * size.width, previousCharacters.begin() + top * size.width);
+            std::copy(previousRowHashes.begin() + top + bestShift, previousRowHashes.begin() + bottom, previousRowHashes.begin() + top);
+        } else {
+            std::copy_backward(previousCharacters.begin() + top * size.width, previousCharacters.begin() + (bottom + bestShift) * size.width, previousCharacters.begin() + bottom * size.width);
+            std::copy_backward(previousRowHashes.begin() + top, previousRowHashes.begin() + bottom + bestShift, previousRowHashes.begin() + bottom);
+        }
+
+        auto exposedBegin = (bestShift > 0) ? bottom - bestShift : top;
+        auto exposedEnd = (bestShift > 0) ? bottom : top - bestShift;
+        auto invalid = invalidCharacter();
+        std::fill(previousCharacters.begin() + exposedBegin * size.width, previousCharacters.begin() + exposedEnd * size.width, invalid);
+        std::fill(previousRowHashes.begin() + exposedBegin, previousRowHashes.begin() + exposedEnd, hashCharacter(invalid) * hashWeightsSum);
+        for (int y = exposedBegin; y < exposedEnd; ++y) {
+            damageRow(y, 0, size.width);
+        }
     }
+}
 
-    int currentStyleHash = 0;
-    int curX = -1;
-    int curY = -1;
-    for (int y = 0; y < size.height; ++y) {
-        for (int i = 0; i < size.width; ++i) {
-            const auto& character = characters[y * size.width + i];
-            if (character.width == 0)
+bool ScreenBuffer::reprintUpTo(TerminalEncoder& encoder, int x, int y) {
+    auto cursorX = encoder.getCursorX();
+    if ((encoder.getCursorY() != y) || (cursorX < 0) || (cursorX >= x))
+        return false;
+
+    auto budget = encoder.moveCost(x, y);
+    int cost = 0;
+    for (int i = cursorX; i < x; ) {
+        const auto& character = characters[y * size.width + i];
+        if (character.getWidth() <= 0)
+            return false;
+        if (!encoder.hasAttributes(character.getAttributes()))
+            return false;
+
+        cost += static_cast<int>(glyphTable.getText(character.glyph).size());
+        if (cost >= budget)
+            return false;
+
+        i += character.getWidth();
+    }
+
+    for (int i = cursorX; i < x; ) {
+        const auto& character = characters[y * size.width + i];
+        encoder.print(glyphTable.getText(character.glyph), character.getWidth());
+        i += character.getWidth();
+    }
+
+    return true;
+}
+
+int ScreenBuffer::drawRow(TerminalEncoder& encoder, int y, int startX, int endX) {
+    for (int i = startX; i < endX; ) {
+        const auto& character = characters[y * size.width + i];
+        if (character.getWidth() == 0) {
+            ++i;
+            continue;
+        }
+
+        if (!fullRepaintNeeded) {
+            const auto& previousCharacter = previousCharacters[y * size.width + i];
+            if (previousCharacter == character) {
+                ++i;
                 continue;
+            }
+        }
 
-            if (!fullRepaintNeeded) {
-                const auto& previousCharacter = previousCharacters[y * size.width + i];
-                if (previousCharacter == character)
-                    continue;
+        if (!encoder.isCursorAt(i, y) && !reprintUpTo(encoder, i, y)) {
+            encoder.moveTo(i, y);
+        }
+
+        i = drawRun(encoder, i, y, endX);
+    }
+
+    return endX;
+}
+
+void ScreenBuffer::repaintInBands() {
+    auto bandCount = std::min(size.height, workerPool->getThreadCount() + 1);
+    if (static_cast<int>(bandOutputs.size()) < bandCount) {
+        bandOutputs.resize(static_cast<size_t>(bandCount));
+    }
+
+    // Bands only read the screen buffer, and each writes only to it's own output.
+    workerPool->run(bandCount, [this, bandCount](int band) {
+        auto& bandOutput = bandOutputs[static_cast<size_t>(band)];
+        bandOutput.clear();
+        TerminalEncoder encoder(bandOutput, capabilities, size);
+
+        auto beginY = band * size.height / bandCount;
+        auto endY = (band + 1) * size.height / bandCount;
+        for (int y = beginY; y < endY; ++y) {
+            drawRow(encoder, y, 0, size.width);
+        }
+    });
+
+    for (int band = 0; band < bandCount; ++band) {
+        const auto& bandOutput = bandOutputs[static_cast<size_t>(band)];
+        output.append(gsl::span<const char>(bandOutput.data(), static_cast<std::ptrdiff_t>(bandOutput.size())));
+    }
+
+    // Screen now shows all characters.
+    previousCharacters = characters;
+    previousRowHashes = rowHashes;
+    std::fill(damage.begin(), damage.end(), RowDamage{size.width, 0});
+}
+
+int ScreenBuffer::drawRun(TerminalEncoder& encoder, int x, int y, int& endX) {
+    const auto& capabilities = encoder.getCapabilities();
+    const auto* row = &characters[y * size.width];
+    const auto* previousRow = &previousCharacters[y * size.width];
+    const auto& character = row[x];
+    auto text = glyphTable.getText(character.glyph);
+    auto attributes = character.getAttributes();
+
+    encoder.setAttributes(attributes);
+
+    if (character.getWidth() == 1) {
+        // Find run of equal cells. Only cells up to the last changed one have to be drawn.
+        auto runEnd = x + 1;
+        while ((runEnd < endX) && (row[runEnd] == character)) {
+            ++runEnd;
+        }
+        if (!fullRepaintNeeded) {
+            while ((runEnd > x + 1) && (previousRow[runEnd - 1] == row[runEnd - 1])) {
+                --runEnd;
             }
+        }
 
-            if ((i != curX) || (y != curY)) {
-                curX = i;
-                curY = y;
-                cursor_goto(ss, curX, curY);
+        auto count = runEnd - x;
+        auto textSize = static_cast<int>(text.size());
+        auto printCost = count * textSize;
+
+        // Erased cells are drawn only with background color, so styles that are visible on spaces can't be erased.
+        auto isBlank = capabilities.backColorErase && (textSize == 1) && (text[0] == ' ')
+                    && !hasStyle(attributes.style, Style::Underline) && !hasStyle(attributes.style, Style::Reverse);
+        if (isBlank) {
+            // Blank cells up to the end of the row can be erased with EL, which is three bytes long.
+            auto lineEnd = runEnd;
+            while ((lineEnd < size.width) && (row[lineEnd] == character)) {
+                ++lineEnd;
+            }
+            if ((lineEnd == size.width) && (printCost > 3)) {
+                encoder.eraseToEndOfLine();
+                endX = size.width;
+                return size.width;
             }
 
-            currentStyleHash = setStyle(ss, currentStyleHash, character.attributes);
-            if (debugPrint) {
-                flushToScreen();
+            // ECH doesn't move the cursor, so moving after the erased cells is also counted.
+            if (capabilities.eraseCharacters && (2 * TerminalEncoder::csiCost(count) < printCost)) {
+                encoder.eraseCharacters(count);
+                return runEnd;
             }
+        }
 
-#if defined(WIN32) && (USE_WIN32_CONSOLE == 1)
-            DWORD numberOfCharsWritten;
-            if (!WriteConsoleA(hOut, character.text.c_str(), character.text.size(), &numberOfCharsWritten, NULL)) {
-                ZTHROW() << "Error while writing to console: " << GetLastError();
+        if (capabilities.repeatCharacter && (count > 1) && (textSize + TerminalEncoder::csiCost(count - 1) < printCost)) {
+            encoder.print(text, 1);
+            encoder.repeat(count - 1);
+            return runEnd;
+        }
+    }
+
+    encoder.print(text, character.getWidth());
+    return x + std::max<int>(character.getWidth(), 1);
+}
+
+void ScreenBuffer::undoLastFrame() {
+    presentedCursor = undoCursor;
+    presentedCursorVisible = undoCursorVisible;
+
+    if (undoNeedsFullRepaint) {
+        fullRepaintNeeded = true;
+        return;
+    }
+
+    // Spans are restored in reverse order, their old contents are at the end of undoCharacters.
+    auto offset = undoCharacters.size();
+    for (auto undoSpan = undoSpans.rbegin(); undoSpan != undoSpans.rend(); ++undoSpan) {
+        auto length = static_cast<size_t>(undoSpan->end - undoSpan->begin);
+        offset -= length;
+        std::copy(undoCharacters.begin() + offset, undoCharacters.begin() + offset + length, previousCharacters.begin() + (undoSpan->y * size.width + undoSpan->begin));
+        previousRowHashes[undoSpan->y] = undoSpan->previousRowHash;
+        damageRow(undoSpan->y, undoSpan->begin, undoSpan->end);
+    }
+}
+
+void ScreenBuffer::present() {
+    // Previous frame didn't reach the terminal, so this frame must include it's changes.
+    if (terminalWriter && terminalWriter->reclaimPendingFrame()) {
+        undoLastFrame();
+    }
+    undoSpans.clear();
+    undoCharacters.clear();
+    undoNeedsFullRepaint = fullRepaintNeeded;
+    undoCursor = presentedCursor;
+    undoCursorVisible = presentedCursorVisible;
+
+    // Whole frame is built in the output buffer, and written to the terminal at once.
+    output.clear();
+    TerminalEncoder encoder(output, capabilities, size);
+
+    // Begin Synchronized Update. Terminal will show the frame only after End Synchronized Update.
+    if (capabilities.synchronizedOutput) {
+        output.append("\x1b[?2026h");
+    }
+    auto frameBegin = output.size();
+
+    bool debugPrint = false;
+
+    // Clear screen.
+    if (debugPrint) {
+        output.append("\x1b[2J");
+    }
+
+    if (!fullRepaintNeeded && capabilities.scrollRegion) {
+        scrollMovedRows(encoder);
+    }
+
+    if (fullRepaintNeeded && workerPool && (size.width * size.height >= minCellsForParallelRepaint)) {
+        repaintInBands();
+    } else {
+        for (int y = 0; y < size.height; ++y) {
+            auto startX = 0;
+            auto endX = size.width;
+
+            if (!fullRepaintNeeded) {
+                // Row was not drawn to.
+                const auto& rowDamage = damage[y];
+                if (rowDamage.begin >= rowDamage.end)
+                    continue;
+
+                // Row was drawn to, but it's contents didn't change. Hashes can collide, so damaged part of the row is compared too.
+                auto row = characters.begin() + y * size.width;
+                auto previousRow = previousCharacters.begin() + y * size.width;
+                if ((rowHashes[y] == previousRowHashes[y]) && std::equal(row + rowDamage.begin, row + rowDamage.end, previousRow + rowDamage.begin)) {
+                    clearRowDamage(y);
+                    continue;
+                }
+
+                // Start from the first cell of a grapheme.
+                startX = rowDamage.begin;
+                endX = rowDamage.end;
+                while ((startX > 0) && (characters[y * size.width + startX].getWidth() == 0)) {
+                    --startX;
+                }
             }
-#else
-            ss << character.text;
-            if (debugPrint) {
-                flushToScreen();
+
+            endX = drawRow(encoder, y, startX, endX);
+
+            if (terminalWriter && !undoNeedsFullRepaint) {
+                undoSpans.push_back(UndoSpan{y, startX, endX, previousRowHashes[y]});
+                undoCharacters.insert(undoCharacters.end(), previousCharacters.begin() + (y * size.width + startX), previousCharacters.begin() + (y * size.width + endX));
             }
-#endif
 
-            curX += character.width;
+            // Screen now shows the damaged part of the row.
+            std::copy(characters.begin() + (y * size.width + startX), characters.begin() + (y * size.width + endX), previousCharacters.begin() + (y * size.width + startX));
+            previousRowHashes[y] = rowHashes[y];
+            clearRowDamage(y);
         }
+    }
 
-        ZASSERT(curX <= size.width);
+    // Hardware cursor is positioned after all cells are drawn. Frame that only moves the cursor doesn't need synchronized output.
+    bool cellsDrawn = output.size() > frameBegin;
+    if (!cellsDrawn) {
+        output.clear();
+        frameBegin = 0;
+    }
+    if (cursor) {
+        if ((cellsDrawn || (presentedCursor != cursor)) && !encoder.isCursorAt(cursor->x, cursor->y)) {
+            encoder.moveTo(cursor->x, cursor->y);
+        }
+        if (!presentedCursorVisible) {
+            output.append("\x1b[?25h");
+        }
+        presentedCursor = cursor;
+        presentedCursorVisible = true;
+    } else {
+        if (presentedCursorVisible) {
+            output.append("\x1b[?25l");
+        }
+        presentedCursor = tl::nullopt;
+        presentedCursorVisible = false;
     }
 
-#if defined(WIN32) && (USE_WIN32_CONSOLE == 1)
-    // All drawing was already done.
-#else
-    flushToScreen();
-#endif
+    if (output.size() > frameBegin) {
+        if (cellsDrawn && capabilities.synchronizedOutput) {
+            output.append("\x1b[?2026l");
+        }
+        if (debugPrint) {
+            LOG() << "Drawing: " << output.str();
+        }
+        if (outputCapture) {
+            outputCapture->append(gsl::span<const char>(output.data(), static_cast<std::ptrdiff_t>(output.size())));
+        } else
+        if (terminalWriter) {
+            terminalWriter->submitFrame(output);
+        } else {
+            auto writeStart = LinkMonitor::Clock::now();
+            writeToTerminal(output.str());
+            linkMonitor.frameWritten(output.size(), LinkMonitor::Clock::now() - writeStart);
+        }
+    }
 
+    frameArena.reset();
     fullRepaintNeeded = false;
-    previousCharacters = characters;
+    compactGlyphTable();
 }
 
 #endif
 
-template<bool UseClipRect>
-void draw_frame_impl(ScreenBuffer& screenBuffer, Rect clipRect, Rect rect, bool doubleEdge, Attributes attributes) {
+void draw_rect(ScreenBuffer& screenBuffer, Rect clipRect, Rect rect, bool doubleEdge, bool fill, Attributes attributes) {
+    if (clipRect.isEmpty())
+        return;
+
+    ZASSERT(Rect(screenBuffer.getSize()).contains(clipRect)) << "Clip rectangle must be fully contained inside the ScreenBuffer.";
+
     auto tl = simpleGrapheme(doubleEdge ? _u8("╔") : _u8("┌"));
     auto tm = simpleGrapheme(doubleEdge ? _u8("═") : _u8("─"));
     auto tr = simpleGrapheme(doubleEdge ? _u8("╗") : _u8("┐"));
@@ -478,46 +986,33 @@ void draw_frame_impl(ScreenBuffer& screenBuffer, Rect clipRect, Rect rect, bool
     auto bm = simpleGrapheme(doubleEdge ? _u8("═") : _u8("─"));
     auto br = simpleGrapheme(doubleEdge ? _u8("╝") : _u8("┘"));
 
-    auto print = [&screenBuffer, clipRect, rect, attributes](int x, int y, const Grapheme& grapheme) {
-        auto pt = Point(x, y) + rect.topLeft.asSize();
-        if (UseClipRect && !clipRect.contains(pt))
+    // Fills given part of the frame (in rect coordinates) with one grapheme.
+    auto fillRun = [&screenBuffer, clipRect, rect, attributes](Rect run, const Grapheme& grapheme) {
+        run.move(rect.topLeft.asSize());
+        run = run.intersect(clipRect);
+        if (run.isEmpty())
             return;
-        screenBuffer.print(pt.x, pt.y, {&grapheme, 1}, attributes);
+        for (int y = run.topLeft.y; y < run.bottomRight().y; ++y) {
+            screenBuffer.fillRun(run.topLeft.x, y, run.size.width, grapheme, attributes);
+        }
     };
 
+    auto width = rect.size.width;
+    auto height = rect.size.height;
+
     // top line
-    print(0, 0, tl);
-    for (int x = 1; x < rect.size.width - 1; x += 1) {
-        print(x, 0, tm);
-    }
-    print(rect.size.width - 1, 0, tr);
+    fillRun(Rect(Point(0, 0), Size(1, 1)), tl);
+    fillRun(Rect(Point(1, 0), Size(width - 2, 1)), tm);
+    fillRun(Rect(Point(width - 1, 0), Size(1, 1)), tr);
 
     // two vertical lines at 1, and at width
-    for (int y = 1; y < rect.size.height - 1; y += 1) {
-        print(0, y, ml);
-        print(rect.size.width - 1, y, mr);
-    }
+    fillRun(Rect(Point(0, 1), Size(1, height - 2)), ml);
+    fillRun(Rect(Point(width - 1, 1), Size(1, height - 2)), mr);
 
     // bottom line
-    print(0, rect.size.height - 1, bl);
-    for (int x = 1; x < rect.size.width - 1; x += 1) {
-        print(x, rect.size.height - 1, bm);
-    }
-    print(rect.size.width - 1, rect.size.height - 1, br);
-}
-
-void draw_rect(ScreenBuffer& screenBuffer, Rect clipRect, Rect rect, bool doubleEdge, bool fill, Attributes attributes) {
-    if (clipRect.isEmpty())
-        return;
-
-    ZASSERT(Rect(screenBuffer.getSize()).contains(clipRect)) << "Clip rectangle must be fully contained inside the ScreenBuffer.";
-
-    if (Rect(screenBuffer.getSize()).contains(clipRect)) {
-        draw_frame_impl<false>(screenBuffer, clipRect, rect, doubleEdge, attributes);
-    }
-    else {
-        draw_frame_impl<true>(screenBuffer, clipRect, rect, doubleEdge, attributes);
-    }
+    fillRun(Rect(Point(0, height - 1), Size(1, 1)), bl);
+    fillRun(Rect(Point(1, height - 1), Size(width - 2, 1)), bm);
+    fillRun(Rect(Point(width - 1, height - 1), Size(1, 1)), br);
 
     if (fill) {
         auto innerRect = Rect(rect.topLeft + Size(1, 1), rect.bottomRight() - Size(1, 1));
@@ -546,6 +1041,14 @@ ScreenCanvas ScreenCanvas::getSubCanvas(Rect rect) {
     return ScreenCanvas(m_screenBuffer, newOrigin, clipRect);
 }
 
+ScreenCanvas ScreenCanvas::getClippedCanvas(Rect screenRect) const {
+    return ScreenCanvas(m_screenBuffer, m_origin, screenRect.intersect(m_clipRect));
+}
+
+FrameArena& ScreenCanvas::getFrameArena() const {
+    return m_screenBuffer.getFrameArena();
+}
+
 void ScreenCanvas::fill(Rect rect, Color bgColor) {
     auto screenRect = rect;
     screenRect.move(m_origin.asSize());
@@ -560,10 +1063,8 @@ void ScreenCanvas::fillRect(Rect rect, bool doubleEdge, bool fill, Attributes at
 }
 
 void ScreenCanvas::print(Point pt, const std::string& text, Attributes normal, Attributes invalid, Attributes replacement) {
-    auto codePointInfos = parseLine(text);
-    auto graphemes = renderLine(codePointInfos);
-
-    print(pt, graphemes, normal, invalid, replacement);
+    auto shapedText = shapeText(text);
+    print(pt, shapedText->graphemes, normal, invalid, replacement);
 }
 
 void ScreenCanvas::print(Point pt, gsl::span<const Grapheme> graphemes, Attributes normal, Attributes invalid, Attributes replacement) {
@@ -574,35 +1075,62 @@ void ScreenCanvas::print(Point pt, gsl::span<const Grapheme> graphemes, Attribut
     if (pt.y >= m_clipRect.bottomRight().y)
         return;
 
-    int curX = pt.x;
-    for (const auto& grapheme : graphemes) {
-        // Skip graphemes beyond left boundary.
-        if (curX + grapheme.width <= m_clipRect.topLeft.x) {
-            curX += grapheme.width;
-            continue;
+    auto clipLeft = m_clipRect.topLeft.x;
+    auto clipRight = m_clipRect.bottomRight().x;
+
+    // Graphemes that fit on the canvas completely are drawn in runs.
+    std::ptrdiff_t runBegin = 0;
+    std::ptrdiff_t runEnd = 0;
+    int runX = pt.x;
+    auto drawRun = [this, &graphemes, &runBegin, &runEnd, &runX, pt, normal]() {
+        if (runEnd > runBegin) {
+            m_screenBuffer.print(runX, pt.y, graphemes.subspan(runBegin, runEnd - runBegin), normal);
         }
+        runBegin = runEnd;
+    };
+
+    int curX = pt.x;
+    for (std::ptrdiff_t index = 0; index < graphemes.size(); ++index) {
+        const auto& grapheme = graphemes[index];
 
         // We need to cut some grapheme into graphemes, because replacements can be clipped char-by-char.
         bool mustClip = (grapheme.kind != GraphemeKind::NORMAL) && (grapheme.width > 1);
 
-        if (!mustClip) {
-            // Draw grapheme only if it fits on the canvas completely.
-            if ((curX >= m_clipRect.topLeft.x) && (curX + grapheme.width <= m_clipRect.bottomRight().x)) {
-                m_screenBuffer.print(curX, pt.y, {&grapheme, 1}, normal);
+        // Extend the run.
+        if (!mustClip && (curX >= clipLeft) && (curX + grapheme.width <= clipRight)) {
+            if (runEnd == runBegin) {
+                runBegin = index;
+                runX = curX;
             }
+            runEnd = index + 1;
+            curX += grapheme.width;
+            if (curX >= clipRight)
+                break;
+            continue;
+        }
+
+        drawRun();
 
+        // Skip graphemes beyond left boundary.
+        if (curX + grapheme.width <= clipLeft) {
+            curX += grapheme.width;
+            continue;
+        }
+
+        if (!mustClip) {
+            // Grapheme doesn't fit on the canvas completely, so it is not drawn.
             curX += grapheme.width;
         } else {
             // We will draw some >> characters to show that the grapheme was clipped.
             ZASSERT(textRendererWidthCache.getWidth(0x3C).value_or(1) == 1);    // '<'
             ZASSERT(textRendererWidthCache.getWidth(0x3E).value_or(1) == 1);    // '>'
 
-            Grapheme lchevron = { GraphemeKind::REPLACEMENT, "\x3C", "Grapheme was clipped by the left edge of the clip rectangle.", 1, grapheme.consumedInput };
-            Grapheme rchevron = { GraphemeKind::REPLACEMENT, "\x3E", "Grapheme was clipped by the right edge of the clip rectangle.", 1, grapheme.consumedInput };
+            // Chevrons are made once, so clipping graphemes doesn't allocate memory.
+            static const Grapheme lchevron = { GraphemeKind::REPLACEMENT, "\x3C", "Grapheme was clipped by the left edge of the clip rectangle.", 1, {} };
+            static const Grapheme rchevron = { GraphemeKind::REPLACEMENT, "\x3E", "Grapheme was clipped by the right edge of the clip rectangle.", 1, {} };
 
-            auto codePointInfosG = parseLine(grapheme.rendered);
-            auto graphemesG = renderLine(codePointInfosG);
-            for (const auto& graphemeG : graphemesG) {
+            auto shapedG = shapeText(grapheme.rendered);
+            for (const auto& graphemeG : shapedG->graphemes) {
                 // Draw grapheme only if it fits on the canvas completely.
                 if ((curX >= m_clipRect.topLeft.x) && (curX + graphemeG.width <= m_clipRect.bottomRight().x)) {
                     m_screenBuffer.print(curX, pt.y, {&graphemeG, 1}, (grapheme.kind == GraphemeKind::INVALID) ? invalid : replacement);
@@ -611,7 +1139,7 @@ void ScreenCanvas::print(Point pt, gsl::span<const Grapheme> graphemes, Attribut
                 else
                 {
                     // Otherwise draw chevrons to show that some grapheme was clipped.
-                    auto chevron = (curX < m_clipRect.topLeft.x) ? lchevron : rchevron;
+                    const auto& chevron = (curX < m_clipRect.topLeft.x) ? lchevron : rchevron;
                     for (int i = 0; i < graphemeG.width; ++i, ++curX) {
                         if ((curX >= m_clipRect.topLeft.x) && (curX + chevron.width <= m_clipRect.bottomRight().x)) {
                             m_screenBuffer.print(curX, pt.y, { &chevron, 1 }, replacement);
@@ -623,9 +1151,11 @@ void ScreenCanvas::print(Point pt, gsl::span<const Grapheme> graphemes, Attribut
         }
 
         // Skip graphemes beyond right boundary.
-        if (curX >= m_clipRect.bottomRight().x)
+        if (curX >= clipRight)
             break;
     }
+
+    drawRun();
 }
 
 } // namespace terminal_editor
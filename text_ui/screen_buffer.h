@@ -3,16 +3,30 @@
 #include "text_parser.h"
 #include "text_renderer.h"
 #include "terminal_io.h"
+#include "glyph_table.h"
+#include "output_buffer.h"
+#include "terminal_capabilities.h"
+#include "link_monitor.h"
 #include "geometry.h"
+#include "frame_arena.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <gsl/span>
+#include <tl/optional.hpp>
 
 namespace terminal_editor {
 
-enum class Color {
+/// Color is a packed 32-bit value.
+/// Named colors have values of SGR parameters that set them as a foreground color (background color parameters are greater by 10).
+/// Colors from the 256 color palette and 24-bit colors are tagged in the highest byte. Use indexedColor() and rgbColor() to create them.
+/// @note Colors that terminal doesn't support are replaced with the nearest supported ones when drawn.
+enum class Color : uint32_t {
     Black	        = 30,
     Red	            = 31,
     Green	        = 32,
@@ -21,6 +35,7 @@ enum class Color {
     Magenta	        = 35,
     Cyan	        = 36,
     White	        = 37,
+    Default	        = 39,   ///< Default color of the terminal.
     Bright_Black	= 90,
     Bright_Red	    = 91,
     Bright_Green	= 92,
@@ -31,18 +46,56 @@ enum class Color {
     Bright_White	= 97,
 };
 
-enum class Style {
+const uint32_t indexedColorTag = 0x01000000;    ///< Tag of colors from the 256 color palette. Index is in the lowest byte.
+const uint32_t rgbColorTag = 0x02000000;        ///< Tag of 24-bit colors. Red, green and blue are in the lower three bytes.
+const uint32_t colorTagMask = 0xFF000000;
+
+/// Returns color from the 256 color palette.
+constexpr Color indexedColor(uint8_t index) {
+    return static_cast<Color>(indexedColorTag | index);
+}
+
+/// Returns 24-bit color.
+constexpr Color rgbColor(uint8_t red, uint8_t green, uint8_t blue) {
+    return static_cast<Color>(rgbColorTag | (static_cast<uint32_t>(red) << 16) | (static_cast<uint32_t>(green) << 8) | blue);
+}
+
+/// Style flags. Flags can be combined with operator|.
+enum class Style : uint8_t {
+    Normal      = 0,
     Bold        = 1,
-    Normal      = 22,
+    Italic      = 2,
+    Underline   = 4,
+    Reverse     = 8,
 };
 
+constexpr Style operator|(Style lhs, Style rhs) {
+    return static_cast<Style>(static_cast<uint8_t>(lhs) | static_cast<uint8_t>(rhs));
+}
+
+/// Returns true if all given flags are set in style.
+constexpr bool hasStyle(Style style, Style flags) {
+    return (static_cast<uint8_t>(style) & static_cast<uint8_t>(flags)) == static_cast<uint8_t>(flags);
+}
+
 struct Attributes {
     Color fgColor;
     Color bgColor;
     Style style;
+
+    bool operator==(const Attributes& other) const {
+        return (fgColor == other.fgColor) && (bgColor == other.bgColor) && (style == other.style);
+    }
+
+    bool operator!=(const Attributes& other) const {
+        return !(*this == other);
+    }
 };
 
 class ScreenBuffer;
+class TerminalEncoder;
+class TerminalWriter;
+class WorkerPool;
 
 class ScreenCanvas {
     ScreenBuffer& m_screenBuffer;
@@ -56,6 +109,18 @@ public:
     /// @param rect     Sub rectangle of this canvas. Rect is relative to this canvas' origin.
     ScreenCanvas getSubCanvas(Rect rect);
 
+    /// Returns canvas with the same origin, that draws only inside given rectangle.
+    /// @param screenRect   Rectangle in screen coordinates. It is clipped to this canvas.
+    ScreenCanvas getClippedCanvas(Rect screenRect) const;
+
+    /// Returns rectangle that this canvas draws in, in screen coordinates.
+    Rect getClipRect() const {
+        return m_clipRect;
+    }
+
+    /// Returns arena for temporary data of the frame being drawn. See ScreenBuffer::getFrameArena().
+    FrameArena& getFrameArena() const;
+
     /// Clears canvas to given color.
     void clear(Color bgColor) {
         auto localRect = m_clipRect;
@@ -78,51 +143,207 @@ public:
     /// Draws given text on the canvas.
     /// Text is clipped to boundaries of the canvas.
     /// So only graphemes fully inside are drawn.
+    /// Consecutive graphemes that fit on the canvas are drawn as one run.
     /// @param graphemes    Graphemes to draw.
     void print(Point pt, gsl::span<const Grapheme> graphemes, Attributes normal, Attributes invalid, Attributes replacement);
 };
 
 class ScreenBuffer {
 public:
+    /// One cell of the screen.
+    /// Attributes and width are packed into one 64-bit word:
+    ///   - bits 0-25:  foreground color (tagged colors use only the two lowest bits of the tag byte),
+    ///   - bits 26-51: background color,
+    ///   - bits 52-59: style,
+    ///   - bits 60-63: width, as 4-bit signed number.
+    /// The word is kept in two halves, so Character is 4-byte aligned and takes 12 bytes.
+    /// @note Character is trivially copyable, so whole rows can be filled and copied as plain memory.
     struct Character {
-        std::string text; ///< UTF-8 text to draw. If empty, then this place will be drawn by preceeding character with width > 1.
-        int width;        ///< Width of text once it will be rendered.
-        Attributes attributes;
+        static const int maxWidth = 7;  ///< Greatest width that fits in the packed word.
+
+        Glyph glyph;            ///< UTF-8 text to draw (text is kept in ScreenBuffer's GlyphTable). If empty, then this place will be drawn by preceeding character with width > 1.
+        uint32_t packed[2];     ///< Low and high half of the packed attributes and width.
+
+        Character() = default;
+
+        /// @param width    Width of text once it will be rendered. Must be between -8 and maxWidth.
+        Character(Glyph glyph, Attributes attributes, int width)
+            : glyph(glyph)
+        {
+            auto word = static_cast<uint64_t>(attributes.fgColor)
+                      | (static_cast<uint64_t>(attributes.bgColor) << 26)
+                      | (static_cast<uint64_t>(attributes.style) << 52)
+                      | (static_cast<uint64_t>(width & 0xF) << 60);
+            packed[0] = static_cast<uint32_t>(word);
+            packed[1] = static_cast<uint32_t>(word >> 32);
+        }
+
+        /// Returns attributes and width packed into one word.
+        uint64_t getPackedWord() const {
+            return packed[0] | (static_cast<uint64_t>(packed[1]) << 32);
+        }
+
+        Attributes getAttributes() const {
+            auto word = getPackedWord();
+            return Attributes{static_cast<Color>(word & 0x3FFFFFF), static_cast<Color>((word >> 26) & 0x3FFFFFF), static_cast<Style>((word >> 52) & 0xFF)};
+        }
+
+        /// Returns width of text once it will be rendered.
+        int getWidth() const {
+            return static_cast<int>((packed[1] >> 28) ^ 8) - 8;
+        }
 
         bool operator==(const Character& other) const {
-            if (text != other.text) return false;
-            if (width != other.width) return false;
-            if (attributes.fgColor != other.attributes.fgColor) return false;
-            if (attributes.bgColor != other.attributes.bgColor) return false;
-            if (attributes.style != other.attributes.style) return false;
-            return true;
+            return (glyph == other.glyph) && (packed[0] == other.packed[0]) && (packed[1] == other.packed[1]);
+        }
+
+        bool operator!=(const Character& other) const {
+            return !(*this == other);
         }
     };
+    static_assert(((indexedColorTag | rgbColorTag | 0xFFFFFF) >> 26) == 0, "Tagged colors should fit in 26 bits of the packed word.");
+    static_assert(std::is_trivially_copyable<Character>::value, "Character should be copied as plain memory.");
+    static_assert(sizeof(Character) == 12, "Character should take three machine words of 32 bits.");
 
 private:
+    /// Range of columns in a row that were drawn to since last present().
+    /// Row is not damaged if begin >= end.
+    struct RowDamage {
+        int begin;
+        int end;
+    };
+
+    /// Part of a row of previousCharacters that was changed by a frame.
+    struct UndoSpan {
+        int y;
+        int begin;
+        int end;
+        uint64_t previousRowHash;   ///< Row hash from before the change.
+    };
+
     Size size;
+    GlyphTable glyphTable;      ///< Texts of all glyphs in characters and previousCharacters that don't fit inline.
+    int glyphCompactionSize;    ///< Size of glyphTable at which present() removes texts of glyphs that are no longer on the screen.
     std::vector<Character> characters;
     std::vector<Character> previousCharacters;
     bool fullRepaintNeeded;     ///< If true while screen will be repainted. Otherwise only changes from previousCharacters will be repainted.
 
+    // Row hashes are sums of hashCharacter(character) * hashWeights[x] (modulo 2^64) over all characters in a row,
+    // so they can be updated in constant time every time a single character changes.
+    std::vector<uint64_t> hashWeights;          ///< Weight of each column in row hashes.
+    uint64_t hashWeightsSum;                    ///< Sum of all hashWeights. Used to compute hash of rows filled with one character.
+    std::vector<uint64_t> rowHashes;            ///< Hash of each row of characters.
+    std::vector<uint64_t> previousRowHashes;    ///< Hash of each row of previousCharacters.
+    std::vector<RowDamage> damage;              ///< Damaged range of each row of characters.
+
+    OutputBuffer output;        ///< Buffer for escape sequences of a frame. Kept between frames to avoid allocations.
+    FrameArena frameArena;      ///< Memory for temporary data of drawing a frame. Reset by present().
+    TerminalCapabilities capabilities;  ///< Optional features of the terminal used by present().
+
+    TerminalWriter* terminalWriter;     ///< If not null, frames are written by it on a separate thread. Otherwise present() writes them itself.
+    OutputBuffer* outputCapture;        ///< If not null, frames are appended to it instead of being written to the terminal.
+
+    LinkMonitor linkMonitor;            ///< Measures how fast frames are written, when there is no terminal writer.
+
+    WorkerPool* workerPool;             ///< If not null, full repaints of large screens are encoded by it in parallel.
+    std::vector<OutputBuffer> bandOutputs;  ///< Escape sequences of each band of rows encoded in parallel. Kept between frames to avoid allocations.
+
+    // Frame submitted to the terminalWriter can be replaced by the next frame before it is written.
+    // Changes it made to previousCharacters are then undone, so the next frame is compared with what the terminal really shows.
+    std::vector<UndoSpan> undoSpans;            ///< Changes of previousCharacters made by the last frame.
+    std::vector<Character> undoCharacters;      ///< Old contents of all undoSpans, one after another.
+    bool undoNeedsFullRepaint;                  ///< True if last frame can't be undone precisely (it was a full repaint, or scrolled rows).
+
+    tl::optional<Point> cursor;                 ///< Where the hardware cursor should be shown by present(). If nullopt cursor is hidden.
+    tl::optional<Point> presentedCursor;        ///< Where the hardware cursor is on the terminal. If nullopt cursor is hidden, or it's position is unknown.
+    bool presentedCursorVisible;                ///< True if the hardware cursor is shown on the terminal.
+    tl::optional<Point> undoCursor;             ///< presentedCursor from before the last frame.
+    bool undoCursorVisible;                     ///< presentedCursorVisible from before the last frame.
+
 public:
     ScreenBuffer()
-        : fullRepaintNeeded(true) {
+        : glyphCompactionSize(minGlyphCompactionSize)
+        , fullRepaintNeeded(true)
+        , hashWeightsSum(0)
+        , capabilities(detectTerminalCapabilities())
+        , terminalWriter(nullptr)
+        , outputCapture(nullptr)
+        , workerPool(nullptr)
+        , undoNeedsFullRepaint(true)
+        , presentedCursorVisible(false)
+        , undoCursorVisible(false) {
     }
 
     ScreenCanvas getCanvas() {
         return ScreenCanvas(*this, Point{0, 0}, getSize());
     }
 
+    /// Returns arena for temporary data of drawing a frame.
+    /// Memory allocated from it is valid until next present().
+    FrameArena& getFrameArena() {
+        return frameArena;
+    }
+
     /// Sets fullRepaintNeeded flag. Used when contents of the screen were changed without ScreenBuffer.
     void setFullRepaintNeeded() {
         fullRepaintNeeded = true;
     }
 
+    /// Marks given rectangle as changed without ScreenBuffer, so only those cells will be repainted by next present().
+    /// Rectangle is extended to cover whole graphemes that were partially inside it.
+    /// Position of the hardware cursor is also forgotten, since it was moved by drawing.
+    /// @param rect     Rectangle in screen coordinates. It is clipped to the screen buffer.
+    void invalidateRect(Rect rect);
+
     Size getSize() const {
         return size;
     }
 
+    const TerminalCapabilities& getTerminalCapabilities() const {
+        return capabilities;
+    }
+
+    /// Makes present() pass frames to given writer, instead of writing them to the terminal directly.
+    /// @param writer   Writer to use, or nullptr to write directly. Writer must outlive all calls to present().
+    void setTerminalWriter(TerminalWriter* writer) {
+        terminalWriter = writer;
+    }
+
+    /// Makes present() append frames to given buffer, instead of writing them to the terminal. Used by tests.
+    /// @param capture  Buffer to append to, or nullptr to write to the terminal. Buffer must outlive all calls to present().
+    void setOutputCapture(OutputBuffer* capture) {
+        outputCapture = capture;
+    }
+
+    /// Makes present() encode full repaints of large screens in bands of rows, on given worker pool.
+    /// @param pool     Pool to use, or nullptr to encode on the calling thread. Pool must outlive all calls to present().
+    void setWorkerPool(WorkerPool* pool) {
+        workerPool = pool;
+    }
+
+    /// Waits until all presented frames are written to the terminal.
+    /// Must be called before writing to the terminal without ScreenBuffer.
+    void waitForOutput();
+
+    /// Returns true if presented frames are still being written to the terminal.
+    /// Frames presented now would only replace the waiting frame, so they can be skipped.
+    /// @note Can be called from any thread, while other thread presents frames.
+    bool isOutputBusy();
+
+    /// Returns true if the terminal doesn't keep up with output, so frames should be made smaller and less frequent.
+    /// @note Can be called from any thread, while other thread presents frames, if terminal writer is set.
+    bool isLinkSaturated();
+
+    /// Returns measured throughput of the link to the terminal in bytes per second, or zero if it wasn't measured yet.
+    /// @note Can be called from any thread, while other thread presents frames, if terminal writer is set.
+    double getLinkThroughput();
+
+    /// Overrides capabilities detected from the environment.
+    void setTerminalCapabilities(const TerminalCapabilities& terminalCapabilities) {
+        capabilities = terminalCapabilities;
+        fullRepaintNeeded = true;
+    }
+
     int getWidth() const {
         return size.width;
     }
@@ -134,9 +355,15 @@ public:
     /// Resizes this screen buffer.
     void resize(int w, int h);
 
-    /// Clears screen to given color.
+    /// Clears screen to given color, and hides the hardware cursor.
     void clear(Color bgColor);
 
+    /// Shows the hardware cursor at given position after next present(), or hides it if position is nullopt.
+    /// @note Hardware cursor is initially assumed to be hidden. It is never shown if this function isn't used.
+    void setCursor(tl::optional<Point> position) {
+        cursor = position;
+    }
+
     /// Draws a filled rectangle with given color.
     /// Rectangle is first clipped to fit the scren buffer.
     void fillRect(Rect rect, Color bgColor);
@@ -151,8 +378,91 @@ public:
     /// @param graphemes    Graphemes to draw.
     void print(int x, int y, gsl::span<const Grapheme> graphemes, Attributes attributes);
 
+    /// Fills a horizontal run of cells with one grapheme.
+    /// Throws if run is not entirely on the screen.
+    /// @param length       Number of cells to fill.
+    /// @param grapheme     Grapheme to fill with. It must have width of 1.
+    void fillRun(int x, int y, int length, const Grapheme& grapheme, Attributes attributes);
+
+    /// Screens with at least this many cells are fully repainted in parallel, if worker pool is set.
+    /// Smaller screens are encoded faster than worker threads wake up.
+    static constexpr int minCellsForParallelRepaint = 16 * 1024;
+
+    /// Glyph table is compacted when it reaches twice the number of glyphs that were kept by the last compaction, but not before it has this many glyphs.
+    /// So glyph table grows only with the number of different glyphs on the screen, and compaction takes constant time per interned glyph.
+    static constexpr int minGlyphCompactionSize = 1024;
+
+    /// Returns number of glyph texts that don't fit inline, and are kept by this screen buffer.
+    int getGlyphCount() const {
+        return glyphTable.size();
+    }
+
     /// Draws this screen buffer to the console.
+    /// Only damaged parts of rows which hash differs from the previous frame are compared with the previous frame.
+    /// Changed cells are encoded with the shortest cursor movements, and runs of equal cells with EL, ECH or REP if the terminal supports them.
+    /// If terminal supports synchronized output, frame is wrapped in BSU/ESU, so terminal shows it at once.
+    /// If terminal writer is set, and the previous frame is still waiting to be written, it is replaced by this frame.
+    /// Hardware cursor is moved only if frame drew something, or if cursor position changed.
     void present();
+
+private:
+    /// Returns character that is different from any character that can be drawn, so it will always be repainted.
+    Character invalidCharacter() {
+        return Character{glyphTable.intern(""), {Color::White, Color::Black, Style::Normal}, -1};
+    }
+
+    /// Returns character that fills cells left by partially overwritten wide graphemes.
+    Character vacuumCharacter() {
+        return Character{glyphTable.intern(" "), {Color::Cyan, Color::Yellow, Style::Normal}, 1};
+    }
+
+    /// Sets one character in the buffer, and updates the hash of it's row.
+    /// @param buffer       Either characters or previousCharacters.
+    /// @param bufferHashes Row hashes of the buffer.
+    void setCharacter(std::vector<Character>& buffer, std::vector<uint64_t>& bufferHashes, int x, int y, Character character);
+
+    /// Extends damaged range of given row by given range of columns.
+    void damageRow(int y, int begin, int end) {
+        auto& rowDamage = damage[y];
+        rowDamage.begin = std::min(rowDamage.begin, begin);
+        rowDamage.end = std::max(rowDamage.end, end);
+    }
+
+    /// Marks given row as not damaged.
+    void clearRowDamage(int y) {
+        damage[y] = RowDamage{size.width, 0};
+    }
+
+    /// Removes texts of glyphs that are no longer used by characters, previousCharacters or undoCharacters, if glyph table has grown enough since the last compaction.
+    void compactGlyphTable();
+
+    /// Restores previousCharacters changed by the last frame, and marks them for repaint.
+    /// Used when last frame was taken back from the terminal writer, before it was written.
+    void undoLastFrame();
+
+    /// Finds ranges of rows that moved vertically since the previous frame, and scrolls them on the terminal.
+    /// previousCharacters are shifted the same way, and rows exposed by scrolling are marked for repaint.
+    /// @note Terminal only scrolls whole rows, so only shifts of full width rows are found.
+    void scrollMovedRows(TerminalEncoder& encoder);
+
+    /// Moves cursor to given position by printing the cells between the cursor and the position again.
+    /// Does nothing if that wouldn't be shorter than the cheapest cursor movement, or if it would require changing attributes.
+    /// @return True if cursor was moved.
+    bool reprintUpTo(TerminalEncoder& encoder, int x, int y);
+
+    /// Draws cells of given part of a row. Cells equal to previousCharacters are skipped, unless full repaint is needed.
+    /// @return End of the part of the row that was drawn. It is extended to the end of the row if EL was used.
+    int drawRow(TerminalEncoder& encoder, int y, int startX, int endX);
+
+    /// Encodes whole screen in bands of rows on the worker pool, and appends them to the output in order.
+    /// Each band starts with unknown cursor position and attributes, so it begins with CUP and SGR that sets all attributes.
+    void repaintInBands();
+
+    /// Draws a run of cells equal to the cell at given position, that ends before endX.
+    /// Uses EL, ECH or REP if that is shorter than printing all cells.
+    /// @param endX     End of the part of the row that is being drawn. If EL is used it is extended to the end of the row.
+    /// @return Position just after the drawn cells.
+    int drawRun(TerminalEncoder& encoder, int x, int y, int& endX);
 };
 
 /// Returns Grapheme that corresponds to given simpleCharacter.
@@ -164,12 +474,21 @@ Grapheme simpleGrapheme(const char (&simpleChar)[N]) {
 
 /// Draws a rectangle with borders.
 /// Rectangle is clipped by the clipRect. clipRect must be wholy inside screen buffer.
+/// Borders are drawn as runs of cells, clipped once per run.
 void draw_rect(ScreenBuffer& screenBuffer, Rect clipRect, Rect rect, bool doubleEdge, bool fill, Attributes attributes);
 
 /// Measures given text on the terminal
+/// Text is drawn in the top left corner of the screen, and only cells it touched are invalidated in the screenBuffer.
 /// @param eventQueue   Event queue to use for listening for the result.
+/// @param screenBuffer Screen buffer that describes current contents of the screen.
 /// @param codePoints   List of code points to measure.
 /// @return Length of the code points. Can be zero.
-int measureText(EventQueue& eventQueue, gsl::span<uint32_t> codePoints);
+int measureText(EventQueue& eventQueue, ScreenBuffer& screenBuffer, gsl::span<uint32_t> codePoints);
+
+/// Asks the terminal whether it supports synchronized output (DEC mode 2026), using DECRQM.
+/// DECRQM is followed by Primary Device Attributes request, which every terminal answers, so terminals that ignore DECRQM don't cause a timeout.
+/// @param eventQueue   Event queue to use for listening for the result.
+/// @return True if terminal supports synchronized output.
+bool querySynchronizedOutput(EventQueue& eventQueue);
 
 } // namespace terminal_editor
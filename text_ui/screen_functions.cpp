@@ -25,6 +25,10 @@ void cursor_goto(std::ostream& os, int x, int y) {
     os << "\x1B[" << (y + 1) << ";" << (x + 1) << "H";
 }
 
+void cursor_goto(OutputBuffer& output, int x, int y) {
+    output.appendCsi(y + 1, x + 1, 'H');
+}
+
 FullscreenOn::FullscreenOn() {
     // Turn on Alternate Screen Bufer
     // DEC Private Mode Set (DECSET)
@@ -60,4 +64,20 @@ HideCursor::~HideCursor() {
     }
 }
 
+CursorShape::CursorShape(int shape) {
+    int ret = std::printf("\x1B[%d q", shape); // Set Cursor Style (DECSCUSR)
+    if (ret < 0)
+        throw std::system_error(errno, std::generic_category(), __func__);
+}
+
+CursorShape::~CursorShape() {
+    try {
+        fputs_ex("\x1B[0 q", stdout, __func__); // Default Cursor Style (DECSCUSR)
+    }
+    catch (std::exception& e) {
+        std::fputs(e.what(), stderr);
+        std::fputs("\n", stderr);
+    }
+}
+
 } // namespace terminal_editor
@@ -4,6 +4,8 @@
 #ifndef SCREEN_FUNCTIONS_H
 #define SCREEN_FUNCTIONS_H
 
+#include "output_buffer.h"
+
 #include <iostream>
 
 namespace terminal_editor {
@@ -26,10 +28,22 @@ public:
     ~HideCursor();
 };
 
+class CursorShape {
+public:
+    // Set Cursor Style (DECSCUSR)
+    // shape is DECSCUSR parameter: 1 - blinking block, 2 - steady block, 3 - blinking underline, 4 - steady underline, 5 - blinking bar, 6 - steady bar.
+    explicit CursorShape(int shape);
+
+    // Restores default cursor style (DECSCUSR 0)
+    ~CursorShape();
+};
+
 /// @note x and y are 0 based.
 void cursor_goto(int x, int y);
 /// @note x and y are 0 based.
 void cursor_goto(std::ostream& os, int x, int y);
+/// @note x and y are 0 based.
+void cursor_goto(OutputBuffer& output, int x, int y);
 
 } // namespace terminal_editor
 
@@ -0,0 +1,83 @@
+#include "terminal_capabilities.h"
+
+#include <cstdlib>
+
+namespace terminal_editor {
+
+namespace {
+
+struct KnownTerminal {
+    const char* prefix;     ///< Prefix of TERM values of this terminal.
+    TerminalCapabilities capabilities;
+};
+
+/// Terminals are matched in order, so longer prefixes must go first.
+/// @note REP is not enabled for "xterm": many terminals that don't support it set TERM to xterm-256color.
+const KnownTerminal knownTerminals[] = {
+    //                      bce     ECH     REP     DECSTBM SU/SD
+    {"xterm",           {   true,   true,   false,  true,   true    }},
+    {"tmux",            {   true,   true,   false,  true,   true    }},
+    {"screen",          {   false,  true,   false,  true,   false   }},
+    {"linux",           {   true,   true,   false,  true,   false   }},
+    {"rxvt",            {   true,   true,   false,  true,   false   }},
+    {"alacritty",       {   true,   true,   false,  true,   true    }},
+    {"foot",            {   true,   true,   true,   true,   true    }},
+    {"vt100",           {   false,  false,  false,  true,   false   }},
+    {"vt102",           {   false,  false,  false,  true,   false   }},
+    {"vt2",             {   false,  true,   false,  true,   false   }},
+    {"vt3",             {   false,  true,   false,  true,   false   }},
+    {"vt4",             {   false,  true,   false,  true,   true    }},
+    {"vt5",             {   false,  true,   false,  true,   true    }},
+};
+
+} // namespace
+
+TerminalCapabilities getTerminalCapabilities(const std::string& terminalType) {
+    TerminalCapabilities capabilities;
+    for (const auto& knownTerminal : knownTerminals) {
+        if (terminalType.compare(0, std::char_traits<char>::length(knownTerminal.prefix), knownTerminal.prefix) == 0) {
+            capabilities = knownTerminal.capabilities;
+            break;
+        }
+    }
+
+    // Color support is part of terminal type name, like in "xterm-256color" or "xterm-direct".
+    if (terminalType.find("-direct") != std::string::npos) {
+        capabilities.colors = ColorSupport::TrueColor;
+    } else if (terminalType.find("256color") != std::string::npos) {
+        capabilities.colors = ColorSupport::Colors256;
+    }
+
+    return capabilities;
+}
+
+TerminalCapabilities detectTerminalCapabilities() {
+#ifdef WIN32
+    // Windows console in virtual terminal mode.
+    TerminalCapabilities capabilities;
+    capabilities.backColorErase = true;
+    capabilities.eraseCharacters = true;
+    capabilities.scrollRegion = true;
+    capabilities.scrollUpDown = true;
+    capabilities.colors = ColorSupport::TrueColor;
+    return capabilities;
+#else
+    const char* term = std::getenv("TERM");
+    auto capabilities = getTerminalCapabilities(term ? term : "");
+
+    // Terminals that support 24-bit colors announce it with COLORTERM.
+    const char* colorTerm = std::getenv("COLORTERM");
+    if (colorTerm && ((std::string(colorTerm) == "truecolor") || (std::string(colorTerm) == "24bit"))) {
+        capabilities.colors = ColorSupport::TrueColor;
+    }
+
+    // Real xterm sets XTERM_VERSION. Unlike terminals that only pretend to be xterm, it supports REP.
+    if (std::getenv("XTERM_VERSION")) {
+        capabilities.repeatCharacter = true;
+    }
+
+    return capabilities;
+#endif
+}
+
+} // namespace terminal_editor
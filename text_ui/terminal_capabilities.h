@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+namespace terminal_editor {
+
+/// Colors terminal can display.
+enum class ColorSupport {
+    Colors16,       ///< Only named colors.
+    Colors256,      ///< 256 color palette.
+    TrueColor,      ///< 24-bit colors.
+};
+
+/// Optional features of the terminal that ScreenBuffer can use to send less data.
+/// Every feature defaults to off, so output works on any ANSI terminal.
+struct TerminalCapabilities {
+    bool backColorErase = false;    ///< Erased cells get the background color of current attributes (terminfo "bce"). Required to draw blank cells with EL and ECH.
+    bool eraseCharacters = false;   ///< Terminal supports ECH (CSI n X).
+    bool repeatCharacter = false;   ///< Terminal supports REP (CSI n b).
+    bool scrollRegion = false;      ///< Terminal supports DECSTBM (CSI top ; bottom r), and scrolls the region with line feed and reverse index.
+    bool scrollUpDown = false;      ///< Terminal supports SU and SD (CSI n S, CSI n T).
+    ColorSupport colors = ColorSupport::Colors16;   ///< Colors that are not supported are replaced with the nearest supported ones.
+    bool synchronizedOutput = false;    ///< Terminal supports synchronized output (DEC mode 2026). It can't be guessed from TERM, use querySynchronizedOutput().
+};
+
+/// Returns capabilities of given type of terminal.
+/// @param terminalType     Value of the TERM environment variable.
+TerminalCapabilities getTerminalCapabilities(const std::string& terminalType);
+
+/// Returns capabilities of the terminal the editor runs in.
+/// Capabilities are guessed from the TERM and COLORTERM environment variables.
+TerminalCapabilities detectTerminalCapabilities();
+
+} // namespace terminal_editor
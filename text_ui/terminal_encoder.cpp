@@ -0,0 +1,483 @@
+#include "terminal_encoder.h"
+
+#include "zerrors.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace terminal_editor {
+
+namespace {
+
+int numberOfDigits(int number) {
+    int digits = 1;
+    while (number >= 10) {
+        number /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+/// Returns number of bytes CUP sequence to given position takes.
+int cursorPositionCost(int x, int y) {
+    if ((x == 0) && (y == 0))
+        return 3;                           // ESC [ H
+    if (x == 0)
+        return 3 + numberOfDigits(y + 1);   // ESC [ y H
+    return 4 + numberOfDigits(y + 1) + numberOfDigits(x + 1);
+}
+
+struct Rgb {
+    int red;
+    int green;
+    int blue;
+};
+
+/// Default palette of xterm for the first 16 colors.
+const Rgb basicColors[16] = {
+    {0, 0, 0},      {205, 0, 0},    {0, 205, 0},    {205, 205, 0},
+    {0, 0, 238},    {205, 0, 205},  {0, 205, 205},  {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0},   {0, 255, 0},    {255, 255, 0},
+    {92, 92, 255},  {255, 0, 255},  {0, 255, 255},  {255, 255, 255},
+};
+
+/// Levels of red, green and blue in the 6x6x6 color cube of the 256 color palette.
+const int cubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+int distance(Rgb lhs, Rgb rhs) {
+    auto red = lhs.red - rhs.red;
+    auto green = lhs.green - rhs.green;
+    auto blue = lhs.blue - rhs.blue;
+    return red * red + green * green + blue * blue;
+}
+
+Rgb paletteColor(int index) {
+    if (index < 16)
+        return basicColors[index];
+
+    if (index < 232) {
+        index -= 16;
+        return {cubeLevels[index / 36], cubeLevels[(index / 6) % 6], cubeLevels[index % 6]};
+    }
+
+    auto level = 8 + 10 * (index - 232);
+    return {level, level, level};
+}
+
+Rgb rgbOf(Color color) {
+    auto value = static_cast<uint32_t>(color);
+    return {static_cast<int>((value >> 16) & 0xFF), static_cast<int>((value >> 8) & 0xFF), static_cast<int>(value & 0xFF)};
+}
+
+/// Returns named color with given index in the 16 color palette.
+Color namedColor(int index) {
+    return static_cast<Color>((index < 8) ? 30 + index : 90 + index - 8);
+}
+
+Color nearestNamedColor(Rgb rgb) {
+    int best = 0;
+    for (int i = 1; i < 16; ++i) {
+        if (distance(rgb, basicColors[i]) < distance(rgb, basicColors[best]))
+            best = i;
+    }
+    return namedColor(best);
+}
+
+/// Returns nearest color from the color cube or the grayscale ramp of the 256 color palette.
+Color nearestIndexedColor(Rgb rgb) {
+    auto nearestLevel = [](int value) {
+        int best = 0;
+        for (int i = 1; i < 6; ++i) {
+            if (std::abs(value - cubeLevels[i]) < std::abs(value - cubeLevels[best]))
+                best = i;
+        }
+        return best;
+    };
+
+    auto cubeIndex = 16 + 36 * nearestLevel(rgb.red) + 6 * nearestLevel(rgb.green) + nearestLevel(rgb.blue);
+
+    auto average = (rgb.red + rgb.green + rgb.blue) / 3;
+    auto grayIndex = 232 + std::min(23, std::max(0, (average - 3) / 10));
+
+    auto index = (distance(rgb, paletteColor(grayIndex)) < distance(rgb, paletteColor(cubeIndex))) ? grayIndex : cubeIndex;
+    return indexedColor(static_cast<uint8_t>(index));
+}
+
+/// SGR parameters of one escape sequence.
+/// Parameters are collected before writing, so that the shorter of two encodings can be chosen.
+class SgrParameters {
+    char m_data[64];
+    int m_size = 0;
+
+public:
+    int size() const {
+        return m_size;
+    }
+
+    gsl::span<const char> data() const {
+        return {m_data, m_size};
+    }
+
+    void add(int param) {
+        ZASSERT((param >= 0) && (m_size + 4 <= static_cast<int>(sizeof(m_data)))) << "Invalid SGR parameter: " << param;
+        if (m_size > 0) {
+            m_data[m_size++] = ';';
+        }
+        if (param >= 100) {
+            m_data[m_size++] = static_cast<char>('0' + param / 100);
+        }
+        if (param >= 10) {
+            m_data[m_size++] = static_cast<char>('0' + (param / 10) % 10);
+        }
+        m_data[m_size++] = static_cast<char>('0' + param % 10);
+    }
+
+    void addColor(Color color, bool background) {
+        auto value = static_cast<uint32_t>(color);
+        switch (value & colorTagMask) {
+            case indexedColorTag:
+                add(background ? 48 : 38);
+                add(5);
+                add(static_cast<int>(value & 0xFF));
+                break;
+            case rgbColorTag: {
+                auto rgb = rgbOf(color);
+                add(background ? 48 : 38);
+                add(2);
+                add(rgb.red);
+                add(rgb.green);
+                add(rgb.blue);
+                break;
+            }
+            default:
+                add(static_cast<int>(value) + (background ? 10 : 0));
+                break;
+        }
+    }
+
+    /// Adds parameters that turn on given style flags.
+    void addStyleOn(Style style) {
+        if (hasStyle(style, Style::Bold))
+            add(1);
+        if (hasStyle(style, Style::Italic))
+            add(3);
+        if (hasStyle(style, Style::Underline))
+            add(4);
+        if (hasStyle(style, Style::Reverse))
+            add(7);
+    }
+
+    /// Adds parameters that turn off given style flags.
+    void addStyleOff(Style style) {
+        if (hasStyle(style, Style::Bold))
+            add(22);
+        if (hasStyle(style, Style::Italic))
+            add(23);
+        if (hasStyle(style, Style::Underline))
+            add(24);
+        if (hasStyle(style, Style::Reverse))
+            add(27);
+    }
+};
+
+} // namespace
+
+TerminalEncoder::TerminalEncoder(OutputBuffer& output, const TerminalCapabilities& capabilities, Size screenSize)
+    : m_output(output)
+    , m_capabilities(capabilities)
+    , m_screenSize(screenSize)
+    , m_cursorX(-1)
+    , m_cursorY(-1)
+    , m_attributes{Color::Default, Color::Default, Style::Normal}
+    , m_attributesKnown(false) {
+}
+
+int TerminalEncoder::csiCost(int param) {
+    return (param == 1) ? 3 : 3 + numberOfDigits(param);
+}
+
+TerminalEncoder::MovePlan TerminalEncoder::planMove(int x, int y) const {
+    MovePlan plan{true, VerticalMove::None, HorizontalMove::None, cursorPositionCost(x, y)};
+
+    if (m_cursorY < 0)
+        return plan;
+
+    // Vertical moves don't change the column.
+    auto vertical = VerticalMove::None;
+    int verticalCost = 0;
+    auto dy = y - m_cursorY;
+    if (dy > 0) {
+        // Terminal doesn't translate line feeds to CR LF in raw mode.
+        vertical = VerticalMove::LineFeeds;
+        verticalCost = dy;
+        if (csiCost(dy) < verticalCost) {
+            vertical = VerticalMove::Down;
+            verticalCost = csiCost(dy);
+        }
+    } else if (dy < 0) {
+        vertical = VerticalMove::Up;
+        verticalCost = csiCost(-dy);
+    }
+    if ((dy != 0) && (csiCost(y + 1) < verticalCost)) {
+        vertical = VerticalMove::Absolute;
+        verticalCost = csiCost(y + 1);
+    }
+
+    // Carriage return and CHA work even if the column is unknown.
+    auto horizontal = HorizontalMove::CarriageReturn;
+    int horizontalCost = 1;
+    if (x > 0) {
+        horizontal = HorizontalMove::CarriageReturnAndRight;
+        horizontalCost = 1 + csiCost(x);
+        if (csiCost(x + 1) < horizontalCost) {
+            horizontal = HorizontalMove::Absolute;
+            horizontalCost = csiCost(x + 1);
+        }
+    }
+    if (m_cursorX >= 0) {
+        auto dx = x - m_cursorX;
+        if (dx == 0) {
+            horizontal = HorizontalMove::None;
+            horizontalCost = 0;
+        } else if ((dx > 0) && (csiCost(dx) < horizontalCost)) {
+            horizontal = HorizontalMove::Right;
+            horizontalCost = csiCost(dx);
+        } else if (dx < 0) {
+            if (-dx < horizontalCost) {
+                horizontal = HorizontalMove::Backspaces;
+                horizontalCost = -dx;
+            }
+            if (csiCost(-dx) < horizontalCost) {
+                horizontal = HorizontalMove::Left;
+                horizontalCost = csiCost(-dx);
+            }
+        }
+    }
+
+    if (verticalCost + horizontalCost < plan.cost) {
+        plan = MovePlan{false, vertical, horizontal, verticalCost + horizontalCost};
+    }
+
+    return plan;
+}
+
+void TerminalEncoder::moveTo(int x, int y) {
+    ZASSERT(Rect(m_screenSize).contains(Point(x, y))) << "Cursor position outside of the screen: " << x << ", " << y;
+
+    auto plan = planMove(x, y);
+    if (plan.absolute) {
+        m_output.append("\x1B[");
+        if ((x != 0) || (y != 0)) {
+            m_output.appendNumber(y + 1);
+        }
+        if (x != 0) {
+            m_output.append(';');
+            m_output.appendNumber(x + 1);
+        }
+        m_output.append('H');
+    } else {
+        switch (plan.vertical) {
+            case VerticalMove::None:
+                break;
+            case VerticalMove::LineFeeds:
+                for (int i = m_cursorY; i < y; ++i) {
+                    m_output.append('\n');
+                }
+                break;
+            case VerticalMove::Down:
+                appendCsi(y - m_cursorY, 'B');
+                break;
+            case VerticalMove::Up:
+                appendCsi(m_cursorY - y, 'A');
+                break;
+            case VerticalMove::Absolute:
+                appendCsi(y + 1, 'd');
+                break;
+        }
+
+        switch (plan.horizontal) {
+            case HorizontalMove::None:
+                break;
+            case HorizontalMove::CarriageReturn:
+                m_output.append('\r');
+                break;
+            case HorizontalMove::CarriageReturnAndRight:
+                m_output.append('\r');
+                appendCsi(x, 'C');
+                break;
+            case HorizontalMove::Right:
+                appendCsi(x - m_cursorX, 'C');
+                break;
+            case HorizontalMove::Backspaces:
+                for (int i = x; i < m_cursorX; ++i) {
+                    m_output.append('\b');
+                }
+                break;
+            case HorizontalMove::Left:
+                appendCsi(m_cursorX - x, 'D');
+                break;
+            case HorizontalMove::Absolute:
+                appendCsi(x + 1, 'G');
+                break;
+        }
+    }
+
+    m_cursorX = x;
+    m_cursorY = y;
+}
+
+Color TerminalEncoder::supportedColor(Color color) const {
+    auto value = static_cast<uint32_t>(color);
+    switch (value & colorTagMask) {
+        case indexedColorTag: {
+            auto index = static_cast<int>(value & 0xFF);
+            if (index < 16)
+                return namedColor(index);
+            if (m_capabilities.colors == ColorSupport::Colors16)
+                return nearestNamedColor(paletteColor(index));
+            return color;
+        }
+        case rgbColorTag:
+            if (m_capabilities.colors == ColorSupport::Colors16)
+                return nearestNamedColor(rgbOf(color));
+            if (m_capabilities.colors == ColorSupport::Colors256)
+                return nearestIndexedColor(rgbOf(color));
+            return color;
+        default:
+            return color;
+    }
+}
+
+bool TerminalEncoder::hasAttributes(Attributes attributes) const {
+    attributes.fgColor = supportedColor(attributes.fgColor);
+    attributes.bgColor = supportedColor(attributes.bgColor);
+    return m_attributesKnown && (attributes == m_attributes);
+}
+
+void TerminalEncoder::setAttributes(Attributes attributes) {
+    attributes.fgColor = supportedColor(attributes.fgColor);
+    attributes.bgColor = supportedColor(attributes.bgColor);
+    if (m_attributesKnown && (attributes == m_attributes))
+        return;
+
+    // Reset all attributes, and set those that are not default.
+    SgrParameters reset;
+    reset.add(0);
+    reset.addStyleOn(attributes.style);
+    if (attributes.fgColor != Color::Default) {
+        reset.addColor(attributes.fgColor, false);
+    }
+    if (attributes.bgColor != Color::Default) {
+        reset.addColor(attributes.bgColor, true);
+    }
+
+    // Change only attributes that differ from the current ones.
+    SgrParameters change;
+    if (m_attributesKnown) {
+        auto currentStyle = static_cast<uint8_t>(m_attributes.style);
+        auto newStyle = static_cast<uint8_t>(attributes.style);
+        change.addStyleOff(static_cast<Style>(currentStyle & ~newStyle));
+        change.addStyleOn(static_cast<Style>(newStyle & ~currentStyle));
+        if (attributes.fgColor != m_attributes.fgColor) {
+            change.addColor(attributes.fgColor, false);
+        }
+        if (attributes.bgColor != m_attributes.bgColor) {
+            change.addColor(attributes.bgColor, true);
+        }
+    }
+
+    const auto& parameters = (m_attributesKnown && (change.size() <= reset.size())) ? change : reset;
+    m_output.append("\x1B[");
+    m_output.append(parameters.data());
+    m_output.append('m');
+
+    m_attributes = attributes;
+    m_attributesKnown = true;
+}
+
+void TerminalEncoder::print(gsl::span<const char> text, int width) {
+    m_output.append(text);
+    advanceCursor(width);
+}
+
+void TerminalEncoder::repeat(int count) {
+    ZASSERT(m_capabilities.repeatCharacter) << "Terminal doesn't support REP.";
+    if (count <= 0)
+        return;
+
+    appendCsi(count, 'b');
+    advanceCursor(count);
+}
+
+void TerminalEncoder::eraseCharacters(int count) {
+    ZASSERT(m_capabilities.eraseCharacters) << "Terminal doesn't support ECH.";
+    if (count <= 0)
+        return;
+
+    appendCsi(count, 'X');
+}
+
+void TerminalEncoder::eraseToEndOfLine() {
+    m_output.append("\x1B[K");
+}
+
+void TerminalEncoder::scrollRows(int top, int bottom, int count) {
+    ZASSERT(m_capabilities.scrollRegion) << "Terminal doesn't support DECSTBM.";
+    ZASSERT((top >= 0) && (top <= bottom) && (bottom < m_screenSize.height)) << "Invalid scroll region: " << top << ", " << bottom;
+    if (count == 0)
+        return;
+
+    auto fullScreen = (top == 0) && (bottom == m_screenSize.height - 1);
+    if (!fullScreen) {
+        m_output.appendCsi(top + 1, bottom + 1, 'r');
+    }
+
+    // DECSTBM moves the cursor to the home position, so it's position can't be used for relative moves.
+    m_cursorX = -1;
+    m_cursorY = -1;
+
+    auto rows = std::abs(count);
+    if (m_capabilities.scrollUpDown) {
+        appendCsi(rows, (count > 0) ? 'S' : 'T');
+    } else if (count > 0) {
+        // Line feed at the bottom margin scrolls the region up.
+        moveTo(0, bottom);
+        for (int i = 0; i < rows; ++i) {
+            m_output.append('\n');
+        }
+    } else {
+        // Reverse index at the top margin scrolls the region down.
+        moveTo(0, top);
+        for (int i = 0; i < rows; ++i) {
+            m_output.append("\x1BM");
+        }
+    }
+
+    if (!fullScreen) {
+        m_output.append("\x1B[r");
+    }
+
+    m_cursorX = -1;
+    m_cursorY = -1;
+}
+
+void TerminalEncoder::appendCsi(int param, char finalByte) {
+    m_output.append("\x1B[");
+    if (param != 1) {
+        m_output.appendNumber(param);
+    }
+    m_output.append(finalByte);
+}
+
+void TerminalEncoder::advanceCursor(int width) {
+    if (m_cursorX < 0)
+        return;
+
+    m_cursorX += width;
+    if (m_cursorX >= m_screenSize.width) {
+        // Terminal is in pending wrap state now. Only absolute column moves and carriage return are reliable.
+        m_cursorX = -1;
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "output_buffer.h"
+#include "terminal_capabilities.h"
+#include "screen_buffer.h"
+#include "geometry.h"
+
+#include <gsl/span>
+
+namespace terminal_editor {
+
+/// Encodes drawing operations as escape sequences for the terminal.
+/// Encoder tracks position of the terminal's cursor and current attributes, so it can choose the shortest sequences.
+/// @note Encoder starts with unknown cursor position and attributes.
+class TerminalEncoder {
+    OutputBuffer& m_output;
+    const TerminalCapabilities& m_capabilities;
+    Size m_screenSize;
+    int m_cursorX;      ///< Column of the cursor, or -1 if it is unknown. It is unknown after writing to the last column, because terminals differ in how they handle pending line wrap.
+    int m_cursorY;      ///< Row of the cursor, or -1 if it is unknown.
+    Attributes m_attributes;    ///< Attributes set on the terminal. Colors are already converted to those supported by the terminal.
+    bool m_attributesKnown;     ///< False if attributes set on the terminal are unknown.
+
+    enum class VerticalMove { None, LineFeeds, Down, Up, Absolute };
+    enum class HorizontalMove { None, CarriageReturn, CarriageReturnAndRight, Right, Backspaces, Left, Absolute };
+
+    /// Cheapest way to move the cursor.
+    struct MovePlan {
+        bool absolute;      ///< If true CUP is used, and vertical and horizontal are ignored.
+        VerticalMove vertical;
+        HorizontalMove horizontal;
+        int cost;           ///< Number of bytes the move takes.
+    };
+
+public:
+    TerminalEncoder(OutputBuffer& output, const TerminalCapabilities& capabilities, Size screenSize);
+
+    const TerminalCapabilities& getCapabilities() const {
+        return m_capabilities;
+    }
+
+    int getCursorX() const {
+        return m_cursorX;
+    }
+
+    int getCursorY() const {
+        return m_cursorY;
+    }
+
+    bool isCursorAt(int x, int y) const {
+        return (m_cursorX == x) && (m_cursorY == y);
+    }
+
+    /// Returns number of bytes that the cheapest cursor movement to given position takes.
+    int moveCost(int x, int y) const {
+        return planMove(x, y).cost;
+    }
+
+    /// Moves the cursor to given position, using the cheapest of: CUP, CUU/CUD/VPA or line feeds, CUF/CUB/CHA, backspaces or carriage return.
+    void moveTo(int x, int y);
+
+    /// Returns true if given attributes are already set on the terminal.
+    bool hasAttributes(Attributes attributes) const;
+
+    /// Sets attributes for following text, using SGR with only the parameters that changed.
+    /// Colors that terminal doesn't support are replaced with the nearest supported ones.
+    void setAttributes(Attributes attributes);
+
+    /// Returns given color converted to the nearest color supported by the terminal.
+    Color supportedColor(Color color) const;
+
+    /// Writes text of one grapheme at the cursor position, and advances the cursor.
+    /// @param width    Number of cells the text occupies.
+    void print(gsl::span<const char> text, int width);
+
+    /// Repeats last printed grapheme given number of times, using REP.
+    /// @note Terminal must support REP, and last printed grapheme must have width 1.
+    void repeat(int count);
+
+    /// Erases given number of cells starting at the cursor, using ECH. Cursor doesn't move.
+    /// @note Terminal must support ECH.
+    void eraseCharacters(int count);
+
+    /// Erases cells from the cursor to the end of the line, using EL. Cursor doesn't move.
+    void eraseToEndOfLine();
+
+    /// Scrolls rows from top to bottom (inclusive) by given number of rows, using DECSTBM. Rows outside of that range don't move.
+    /// Rows exposed by scrolling are erased. Cursor position is unknown afterwards.
+    /// @param count    Positive values move contents up, negative move it down.
+    /// @note Terminal must support DECSTBM.
+    void scrollRows(int top, int bottom, int count);
+
+    /// Returns number of bytes CSI sequence with given parameter takes.
+    /// Parameter equal to 1 is omitted, as it is the default for all sequences the encoder uses.
+    static int csiCost(int param);
+
+private:
+    MovePlan planMove(int x, int y) const;
+
+    /// Appends CSI sequence with given parameter. Parameter equal to 1 is omitted.
+    void appendCsi(int param, char finalByte);
+
+    /// Advances the cursor after writing given number of cells.
+    void advanceCursor(int width);
+};
+
+} // namespace terminal_editor
@@ -16,7 +16,7 @@
 #include <cstdio>
 #include <cstring>
 #include <system_error>
-#include <regex>
+#include <limits>
 //#include <charconv>
 #include <cstdlib>
 
@@ -29,202 +29,83 @@
 
 namespace terminal_editor {
 
-tl::optional<std::string> getActionForEvent(const std::string& contextName, const Event& event, const EditorConfig& editorConfig) {
-    // Check if there is a key map for current context. Fallback to "global" if not found.
-    const KeyMap* startKeyMap = nullptr;
-    if (editorConfig.keyMaps.count(contextName) > 0) {
-        startKeyMap = &editorConfig.keyMaps.at(contextName);
+tl::optional<CsiParams> parseCsiParams(const std::string& parameterBytes) {
+    CsiParams params;
+    auto byte = parameterBytes.begin();
+    if ((byte != parameterBytes.end()) && (*byte >= '<') && (*byte <= '?')) {
+        params.privateMarker = *byte;
+        ++byte;
     }
-    else
-    if (editorConfig.keyMaps.count("global") > 0) {
-        startKeyMap = &editorConfig.keyMaps.at("global");
-    } else {
-        return tl::nullopt;
-    }
-
-    // Currently we support only keyboard shortcuts, mouse events, and CSI escape sequences (in a limited way).
-
-    tl::optional<std::string> onAction;
-    const KeyPressed* keyEvent = std::get_if<KeyPressed>(&event);
-    const MouseEvent* mouseEvent = std::get_if<MouseEvent>(&event);
-    const Esc* esc = std::get_if<Esc>(&event);
-
-    if ((keyEvent == nullptr) && (mouseEvent == nullptr) && (esc == nullptr) && (!onAction))
-        return tl::nullopt;
-
-    auto matchesAction = [&onAction](const KeyMap::KeyBinding& binding) {
-        if (!onAction)
-            return false;
-
-        if (!binding.onAction)
-            return false;
-
-        if (*binding.onAction != *onAction)
-            return false;
-
-        return true;
-    };
-
-    auto matchesKey = [&keyEvent](const KeyMap::KeyBinding& binding) {
-        if (keyEvent == nullptr)
-            return false;
-
-        if (binding.ctrl && !keyEvent->wasCtrlHeld())
-            return false;
-
-        if (binding.key != keyEvent->getUtf8(binding.ctrl))
-            return false;
-
-        return true;
-    };
-
-    auto matchesMouse = [&mouseEvent](const KeyMap::KeyBinding& binding) {
-        if (mouseEvent == nullptr)
-            return false;
-
-        if (!binding.mouseAction)
-            return false;
-
-        if ((*binding.mouseAction == KeyMap::MouseAction::WheelUp) && (mouseEvent->kind == MouseEvent::Kind::WheelUp))
-            return true;
 
-        if ((*binding.mouseAction == KeyMap::MouseAction::WheelDown) && (mouseEvent->kind == MouseEvent::Kind::WheelDown))
-            return true;
+    if (byte == parameterBytes.end())
+        return params;
 
-        return false;
-    };
-
-    const std::regex paramsRegex("(?:([0-9]*)(?:;([0-9]*))*)?");
-
-    auto matchesCsi = [&esc, &paramsRegex](const KeyMap::KeyBinding& binding) {
-        if (esc == nullptr)
-            return false;
-
-        if (!binding.csi)
-            return false;
-
-        if (!esc->isCSI())
-            return false;
-
-        if (!esc->csiIntermediateBytes.empty())
-            return false;
-
-        if (binding.csi->finalByte != esc->csiFinalByte)
-            return false;
-
-        std::smatch match;
-        if (!std::regex_match(esc->csiParameterBytes, match, paramsRegex))
-            return false;
-
-        std::vector<std::string> params;
-        if (!esc->csiParameterBytes.empty()) {
-            params = splitString(esc->csiParameterBytes, ';');
-        }
-        if (binding.csi->params.size() != params.size())
-            return false;
-
-        for (int i = 0; i < static_cast<int>(binding.csi->params.size()); ++i) {
-            int param = params[i].empty() ? 0 : static_cast<int>(std::strtol(params[i].c_str(), nullptr, 10));
-
-            if (binding.csi->params[i] != param)
-                return false;
+    int param = 0;
+    for (; byte != parameterBytes.end(); ++byte) {
+        if (*byte == ';') {
+            if (params.count == CsiParams::maxCount)
+                return tl::nullopt;
+            params.values[params.count++] = param;
+            param = 0;
+            continue;
         }
 
-        return true;
-    };
-
-    auto matchesSs2 = [&esc](const KeyMap::KeyBinding& binding) {
-        if (esc == nullptr)
-            return false;
-
-        if (!binding.ss2)
-            return false;
-
-        if (!esc->isSS2())
-            return false;
-
-        if (*binding.ss2 != esc->ssCharacter)
-            return false;
-
-        return true;
-    };
-
-    auto matchesSs3 = [&esc](const KeyMap::KeyBinding& binding) {
-        if (esc == nullptr)
-            return false;
-
-        if (!binding.ss3)
-            return false;
-
-        if (!esc->isSS3())
-            return false;
-
-        if (*binding.ss3 != esc->ssCharacter)
-            return false;
-
-        return true;
-    };
+        if ((*byte < '0') || (*byte > '9'))
+            return tl::nullopt;
 
-    auto findAction = [&onAction, &matchesAction, &matchesKey, &matchesMouse, &matchesCsi, &matchesSs2, &matchesSs3](const KeyMap& keyMap) -> tl::optional<std::string> {
-        for (const auto& binding : keyMap.bindings) {
-            if (matchesAction(binding))
-                return binding.action;
+        param = (param > (std::numeric_limits<int>::max() - 9) / 10) ? std::numeric_limits<int>::max() : param * 10 + (*byte - '0');
+    }
 
-            // @note If we have an action to translate, we don't look at anything else.
-            //       This is because once we have interpreted the input into an action we don't want to consider this input any more.
-            //       Instead we want to process only the abstract action.
-            if (onAction)
-                continue;
+    if (params.count == CsiParams::maxCount)
+        return tl::nullopt;
+    params.values[params.count++] = param;
+    return params;
+}
 
-            if (matchesKey(binding))
-                return binding.action;
+tl::optional<ActionId> getActionForEvent(const std::string& contextName, const Event& event, const EditorConfig& editorConfig) {
+    const auto& keyMapIndex = editorConfig.keyMapIndex;
 
-            if (matchesMouse(binding))
-                return binding.action;
+    // Currently we support only keyboard shortcuts, mouse events, and CSI escape sequences (in a limited way).
 
-            if (matchesCsi(binding))
-                return binding.action;
+    if (auto keyEvent = std::get_if<KeyPressed>(&event)) {
+        tl::optional<uint32_t> ctrlCodePoint;
+        if (keyEvent->wasCtrlHeld()) {
+            // Ctrl key strips high 3 bits from character on input.
+            ctrlCodePoint = keyEvent->codePoint | 0x40;
+        }
+        return keyMapIndex.findKeyAction(contextName, keyEvent->codePoint, ctrlCodePoint);
+    }
 
-            if (matchesSs2(binding))
-                return binding.action;
+    if (auto mouseEvent = std::get_if<MouseEvent>(&event)) {
+        if (mouseEvent->kind == MouseEvent::Kind::WheelUp)
+            return keyMapIndex.findMouseAction(contextName, KeyMap::MouseAction::WheelUp);
 
-            if (matchesSs3(binding))
-                return binding.action;
-        }
+        if (mouseEvent->kind == MouseEvent::Kind::WheelDown)
+            return keyMapIndex.findMouseAction(contextName, KeyMap::MouseAction::WheelDown);
 
         return tl::nullopt;
-    };
+    }
 
-    std::vector<std::string> matchedActions;
-    const KeyMap* keyMap = startKeyMap;
-    while (true) {
-        auto action = findAction(*keyMap);
-        if (action) {
-            auto position = std::find(matchedActions.begin(), matchedActions.end(), *action);
-            if (position != matchedActions.end()) {
-                std::stringstream ss;
-                for (auto matchedAction : matchedActions) {
-                    ss << matchedAction << " -> ";
-                }
-                ZTHROW() << "Circular action chain: " << ss.str() << "-> " << *action;
-            }
+    if (auto esc = std::get_if<Esc>(&event)) {
+        if (esc->isCSI()) {
+            if (!esc->csiIntermediateBytes.empty())
+                return tl::nullopt;
 
-            matchedActions.push_back(*action);
-            onAction = *action;
-            keyMap = startKeyMap;
-            continue;
-        }
+            auto params = parseCsiParams(esc->csiParameterBytes);
+            if (!params || (params->privateMarker != 0))
+                return tl::nullopt;
 
-        if (!keyMap->parent) {
-            if (!matchedActions.empty()) {
-                return matchedActions.back();
-            }
-            return tl::nullopt;
+            return keyMapIndex.findCsiAction(contextName, esc->csiFinalByte, params->get());
         }
 
-        ZASSERT(editorConfig.keyMaps.count(*keyMap->parent) > 0) << "Key map not found: " << *keyMap->parent;
-        keyMap = &editorConfig.keyMaps.at(*keyMap->parent);
+        if (esc->isSS2())
+            return keyMapIndex.findSsAction(contextName, false, esc->ssCharacter);
+
+        if (esc->isSS3())
+            return keyMapIndex.findSsAction(contextName, true, esc->ssCharacter);
     }
+
+    return tl::nullopt;
 }
 
 TerminalRawMode::TerminalRawMode() {
@@ -365,6 +246,26 @@ tl::optional<Event> EventQueue::poll(bool block) {
     return e;
 }
 
+tl::optional<Event> EventQueue::poll(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (queue.empty()) {
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            cv.wait(lock);
+        } else if (cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+            if (queue.empty())
+                return tl::nullopt;
+        }
+    }
+    Event e = queue.front();
+    queue.pop();
+    return e;
+}
+
+bool EventQueue::hasEvents() {
+    std::unique_lock<std::mutex> lock{mutex};
+    return !queue.empty();
+}
+
 tl::optional<Event> EventQueue::requestAndResponse(std::function<void()> makeRequest, std::function<EventResult(Event)> processEvent, std::chrono::milliseconds timeout)
 {
     std::promise<Event> promise;
@@ -418,25 +319,14 @@ tl::optional<MouseEvent> extractMouseEvent(const Esc& esc) {
     if ((esc.csiFinalByte != 'M') && (esc.csiFinalByte != 'm'))
         return tl::nullopt;
 
-    const std::regex paramsRegex("<([0-9]*);([0-9]*);([0-9]*)");
-    std::smatch match;
-    if (!std::regex_match(esc.csiParameterBytes, match, paramsRegex))
+    // SGR mouse report: CSI < Code ; X ; Y M (or m on release).
+    auto params = parseCsiParams(esc.csiParameterBytes);
+    if (!params || (params->privateMarker != '<') || (params->count != 3))
         return tl::nullopt;
 
-    auto codeMatch = match[1].str();
-    auto xMatch = match[2].str();
-    auto yMatch = match[3].str();
-    if (codeMatch.empty()) codeMatch = "0";
-    if (xMatch.empty()) xMatch = "0";
-    if (yMatch.empty()) yMatch = "0";
-    int code = static_cast<int>(std::strtol(codeMatch.c_str(), nullptr, 10));
-    int x = static_cast<int>(std::strtol(xMatch.c_str(), nullptr, 10));
-    int y = static_cast<int>(std::strtol(yMatch.c_str(), nullptr, 10));
-#if 0
-    std::from_chars(codeMatch.data(), codeMatch.data() + codeMatch.size(), code);
-    std::from_chars(xMatch.data(), xMatch.data() + xMatch.size(), x);
-    std::from_chars(yMatch.data(), yMatch.data() + yMatch.size(), y);
-#endif
+    auto code = params->values[0];
+    auto x = params->values[1];
+    auto y = params->values[2];
 
     MouseEvent event;
     event.kind = static_cast<MouseEvent::Kind>(code);
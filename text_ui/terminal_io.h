@@ -10,6 +10,7 @@
 #include "console_reader.h"
 #include "zstr.h"
 
+#include <array>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -19,6 +20,7 @@
 #include <functional>
 #include <chrono>
 #include <tl/optional.hpp>
+#include <gsl/span>
 
 #ifndef WIN32
 #include <termios.h>
@@ -133,6 +135,25 @@ struct Esc {
     char csiFinalByte;
 };
 
+/// Parameters of a CSI sequence, parsed without allocating memory.
+struct CsiParams {
+    static constexpr int maxCount = 16;  ///< Sequences with more parameters are not supported.
+
+    char privateMarker = 0;         ///< Private parameter marker ('<', '=', '>' or '?') that precedes parameters, or 0 if there is none.
+    int count = 0;                  ///< Number of parameters.
+    std::array<int, maxCount> values;   ///< Parameters. Empty parameters are zeros.
+
+    /// Returns parsed parameters.
+    gsl::span<const int> get() const {
+        return gsl::span<const int>(values.data(), count);
+    }
+};
+
+/// Parses parameter bytes of a CSI sequence. Doesn't allocate memory.
+/// Parameters that don't fit in int are saturated.
+/// @return Parsed parameters, or nullopt if parameter bytes contain sub-parameters, private marker not at the start, or more than CsiParams::maxCount parameters.
+tl::optional<CsiParams> parseCsiParams(const std::string& parameterBytes);
+
 /// Error event describes any kind of error while processing event read from the terminal. Usually a malformed or unknown escape sequence, or invalid character.
 struct Error {
     std::string msg;    ///< UTF-8 string with error message.
@@ -188,7 +209,7 @@ using Event = std::variant<KeyPressed, Esc, Error, BrokenInput, WindowSize, Mous
 /// @param contextName      Name of the key map to use.
 /// @param event            Event to check for actions in key map.
 /// @param editorConfig     EditorConfig that contains key maps.
-tl::optional<std::string> getActionForEvent(const std::string& contextName, const Event& event, const EditorConfig& editorConfig);
+tl::optional<ActionId> getActionForEvent(const std::string& contextName, const Event& event, const EditorConfig& editorConfig);
 
 class EventQueue {
 public:
@@ -200,6 +221,14 @@ public:
     /// @param block    If true the function will not return until an event is available. Otherwise it will return none if event is not available.
     tl::optional<Event> poll(bool block);
 
+    /// Returns one event from the queue.
+    /// Waits for an event until given deadline. Returns none if no event was available before the deadline.
+    /// @param deadline     Time until which to wait. Deadlines in the past don't wait. std::chrono::steady_clock::time_point::max() waits forever.
+    tl::optional<Event> poll(std::chrono::steady_clock::time_point deadline);
+
+    /// Returns true if there are events in the queue.
+    bool hasEvents();
+
     /// Used as result for requestAndResponse()'s processEvent parameter.
     struct EventResult {
         EventResult(bool consumed, bool finished) : consumed(consumed), finished(finished) {}
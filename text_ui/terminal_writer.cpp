@@ -0,0 +1,108 @@
+#include "terminal_writer.h"
+
+#include "zerrors.h"
+
+#include <utility>
+
+namespace terminal_editor {
+
+TerminalWriter::TerminalWriter()
+    : m_hasPendingFrame(false)
+    , m_writing(false)
+    , m_stop(false)
+    , m_thread(&TerminalWriter::loop, this) {
+}
+
+TerminalWriter::~TerminalWriter() {
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+bool TerminalWriter::reclaimPendingFrame() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (!m_hasPendingFrame)
+        return false;
+
+    m_hasPendingFrame = false;
+    m_pendingFrame.clear();
+    return true;
+}
+
+void TerminalWriter::submitFrame(OutputBuffer& frame) {
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        checkError();
+        ZASSERT(!m_hasPendingFrame) << "Previous frame is still pending.";
+
+        std::swap(m_pendingFrame, frame);
+        m_hasPendingFrame = true;
+    }
+    m_cv.notify_all();
+    frame.clear();
+}
+
+void TerminalWriter::waitUntilWritten() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_cv.wait(lock, [this]() { return (!m_hasPendingFrame && !m_writing) || m_error; });
+    checkError();
+}
+
+bool TerminalWriter::isBusy() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_hasPendingFrame || m_writing;
+}
+
+LinkMonitor TerminalWriter::getLinkMonitor() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_linkMonitor;
+}
+
+void TerminalWriter::loop() {
+    OutputBuffer frame;
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+        m_cv.wait(lock, [this]() { return m_hasPendingFrame || m_stop; });
+
+        // Pending frame is written even when stopping, so the terminal shows the last frame.
+        if (!m_hasPendingFrame)
+            break;
+
+        std::swap(frame, m_pendingFrame);
+        m_hasPendingFrame = false;
+        m_writing = true;
+
+        lock.unlock();
+        auto writeStart = LinkMonitor::Clock::now();
+        try {
+            writeToTerminal(frame.str());
+        }
+        catch (...) {
+            lock.lock();
+            m_error = std::current_exception();
+            m_writing = false;
+            m_cv.notify_all();
+            break;
+        }
+        auto writeTime = LinkMonitor::Clock::now() - writeStart;
+        lock.lock();
+
+        m_linkMonitor.frameWritten(frame.size(), writeTime);
+        frame.clear();
+        m_writing = false;
+        m_cv.notify_all();
+    }
+}
+
+void TerminalWriter::checkError() {
+    // Writer thread has exited, so error is never cleared.
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "output_buffer.h"
+#include "link_monitor.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace terminal_editor {
+
+/// TerminalWriter writes frames to the terminal on a separate thread, so slow terminal never blocks input handling and drawing.
+/// There is only one place for a frame waiting to be written. Frame that wasn't taken by the writer thread yet can be reclaimed,
+/// so it can be replaced by a newer frame, that includes it's changes.
+/// @note Buffers are swapped, not copied, so writing frames doesn't allocate memory once buffers have grown.
+class TerminalWriter {
+    std::mutex m_mutex;
+    std::condition_variable m_cv;   ///< Signalled when frame is submitted, when writing ends, and on stop.
+    OutputBuffer m_pendingFrame;    ///< Frame waiting to be written.
+    bool m_hasPendingFrame;         ///< True if m_pendingFrame wasn't taken by the writer thread yet.
+    bool m_writing;                 ///< True while writer thread writes a frame.
+    bool m_stop;                    ///< Tells writer thread to exit.
+    std::exception_ptr m_error;     ///< Error that happened on the writer thread. It is rethrown by submitFrame() and waitUntilWritten().
+    LinkMonitor m_linkMonitor;      ///< Measures how fast frames are written.
+    std::thread m_thread;           ///< This must be last to make sure thread starts after all members are initialized.
+
+public:
+    TerminalWriter();
+
+    /// Writes all submitted frames, and stops the writer thread.
+    ~TerminalWriter();
+
+    TerminalWriter(const TerminalWriter&) = delete;
+    TerminalWriter& operator=(const TerminalWriter&) = delete;
+
+    /// Takes back the frame that is waiting to be written, if the writer thread didn't start writing it yet.
+    /// Changes from that frame will not reach the terminal.
+    /// @return True if frame was reclaimed.
+    bool reclaimPendingFrame();
+
+    /// Passes frame to the writer thread. Never waits for the terminal.
+    /// @param frame    Frame to write. It is swapped with a buffer of a frame that was already written, so it can be reused.
+    /// @note There must be no pending frame. Use reclaimPendingFrame() first.
+    void submitFrame(OutputBuffer& frame);
+
+    /// Waits until all submitted frames are written to the terminal.
+    /// Used before writing to the terminal directly.
+    void waitUntilWritten();
+
+    /// Returns true if a frame is being written, or waits to be written.
+    bool isBusy();
+
+    /// Returns copy of the monitor of the link to the terminal.
+    LinkMonitor getLinkMonitor();
+
+private:
+    /// Thread function.
+    void loop();
+
+    /// Rethrows error from the writer thread, if there was one.
+    /// @note Must be called under mutex.
+    void checkError();
+};
+
+} // namespace terminal_editor
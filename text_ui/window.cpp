@@ -1,14 +1,60 @@
 #include "window.h"
 
+#include "shaped_text_cache.h"
+
 #include <limits>
 
 namespace terminal_editor {
 
+void WindowSnapshot::draw(ScreenCanvas& parentCanvas, const Region& dirtyRegion) const {
+    // Draw items and visible regions are allocated from the frame arena, so compositing them doesn't allocate memory.
+    auto& arena = parentCanvas.getFrameArena();
+
+    ArenaVector<DrawItem> items{ArenaAllocator<DrawItem>(arena)};
+    collectDrawItems(parentCanvas, items);
+
+    // Each window can be covered only by windows drawn after it, so visible regions are computed from the last window.
+    using FrameRegion = BasicRegion<ArenaAllocator<Rect>>;
+    ArenaVector<FrameRegion> visibleRegions{ArenaAllocator<FrameRegion>(arena)};
+    visibleRegions.reserve(items.size());
+    for (auto item = items.rbegin(); item != items.rend(); ++item) {
+        FrameRegion visibleRegion(item->canvas.getClipRect(), ArenaAllocator<Rect>(arena));
+        for (auto later = items.rbegin(); later != item; ++later) {
+            if (visibleRegion.isEmpty())
+                break;
+            visibleRegion.subtract(later->canvas.getClipRect());
+        }
+        visibleRegions.push_back(std::move(visibleRegion));
+    }
+    std::reverse(visibleRegions.begin(), visibleRegions.end());
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        for (auto visibleRect : visibleRegions[i].rects()) {
+            for (auto dirtyRect : dirtyRegion.rects()) {
+                auto drawRect = visibleRect.intersect(dirtyRect);
+                if (drawRect.isEmpty())
+                    continue;
+                auto visibleCanvas = items[i].canvas.getClippedCanvas(drawRect);
+                items[i].window->drawSelf(visibleCanvas);
+            }
+        }
+    }
+}
+
+void WindowSnapshot::collectDrawItems(ScreenCanvas& parentCanvas, ArenaVector<DrawItem>& items) const {
+    auto windowCanvas = parentCanvas.getSubCanvas(rect);
+    items.push_back(DrawItem{this, windowCanvas});
+    for (auto& child : children) {
+        child->collectDrawItems(windowCanvas, items);
+    }
+}
+
 Window::Window(WindowManager* windowManager, const std::string& name, Rect rect)
     : m_windowManager(windowManager)
     , m_name(name)
     , m_parent(nullptr)
     , m_rect(rect)
+    , m_screenRect(rect)
 {
     m_windowManager->windowCreated(this);
 }
@@ -27,85 +73,175 @@ void Window::close() {
     }
 }
 
-bool Window::doProcessAction(const std::string& action) {
-    if (action == "close") {
-        if (m_parent) {
-            close();
-        }
-        return true;
-    }
+bool Window::doProcessAction(ActionId action) {
+    // @note Window may be closed by this, so it must be the last thing done.
+    return getActionTable().dispatch(*this, action);
+}
 
-    if (action == "hello") {
-        messageBox(this, "Hello!");
-        return true;
-    }
+const ActionTable<Window>& Window::getActionTable() {
+    static const auto actionTable = []() {
+        ActionTable<Window> table;
+
+        table.add("close", [](Window& window) {
+            if (window.m_parent) {
+                window.close();
+            }
+        });
+
+        table.add("hello", [](Window& window) {
+            messageBox(&window, "Hello!");
+        });
 
-    return false;
+        return table;
+    }();
+    return actionTable;
 }
 
-void BasicWindow::drawSelf(ScreenCanvas& windowCanvas) {
-    auto localRect = Rect{Point{0, 0}, getRect().size};
-    auto attributes = m_attributes;
-    if (getWindowManager()->getFocusedWindow() == this) {
-        attributes.fgColor = Color::Bright_Red;
+/// Snapshot of a window that doesn't overlap the dirty region.
+/// It is used only to compute which parts of other windows are covered.
+class CleanWindowSnapshot : public WindowSnapshot {
+public:
+    using WindowSnapshot::WindowSnapshot;
+
+private:
+    void drawSelf(ScreenCanvas& windowCanvas) const override {
+        ZUNUSED(windowCanvas);
+        ZASSERT(false) << "Window outside of the dirty region can't be drawn.";
     }
-    windowCanvas.fillRect(localRect, m_doubleEdge, true, attributes);
+};
 
-    auto messageLength = getRenderedWidth(m_message);
+const WindowSnapshot* Window::snapshot(const Region& dirtyRegion, FrameArena& arena) const {
+    auto screenRect = getScreenRect();
+    auto isDirty = std::any_of(dirtyRegion.rects().begin(), dirtyRegion.rects().end(), [screenRect](Rect dirtyRect) { return dirtyRect.overlap(screenRect); });
 
-    auto point = localRect.center();
-    point.x = (localRect.size.width - messageLength) / 2 - 1;
-    point.y--;
-    auto textCanvas = windowCanvas.getSubCanvas({{1, 1}, Size{localRect.size.width - 2, localRect.size.height - 2}});
-    textCanvas.print(point, m_message, m_attributes, m_attributes, m_attributes);
+    WindowSnapshot* windowSnapshot;
+    if (isDirty) {
+        windowSnapshot = snapshotSelf(dirtyRegion, arena);
+    } else {
+        windowSnapshot = arena.create<CleanWindowSnapshot>(arena);
+    }
+    windowSnapshot->rect = getRect();
+    windowSnapshot->children.reserve(m_children.size());
+    for (auto& child : m_children) {
+        windowSnapshot->children.push_back(child->snapshot(dirtyRegion, arena));
+    }
+    return windowSnapshot;
 }
 
-bool BasicWindow::doProcessAction(const std::string& action) {
-    if (action == "left") {
-        getRect().move({-1, 0});
-        return true;
-    }
+void Window::layoutChanged() {
+    updateScreenRect();
+    m_windowManager->layoutChanged();
+}
 
-    if (action == "right") {
-        getRect().move({1, 0});
-        return true;
+void Window::updateScreenRect() {
+    m_screenRect = m_rect;
+    if (m_parent) {
+        m_screenRect.move(m_parent->m_screenRect.topLeft.asSize());
     }
-
-    if (action == "up") {
-        getRect().move({0, -1});
-        return true;
+    for (auto& child : m_children) {
+        child->updateScreenRect();
     }
+}
 
-    if (action == "down") {
-        getRect().move({0, 1});
-        return true;
+void Window::addToHitTestGrid(HitTestGrid& grid, std::vector<Window*>& windows, Rect clipRect) {
+    clipRect = clipRect.intersect(m_screenRect);
+    if (clipRect.isEmpty())
+        return;
+
+    grid.add(clipRect);
+    windows.push_back(this);
+    for (auto& child : m_children) {
+        child->addToHitTestGrid(grid, windows, clipRect);
     }
+}
 
-    if (action == "size-left") {
-        getRect().size.width -= 1;
-        return true;
+tl::optional<Window*> WindowManager::getWindowForPoint(Point screenPoint) {
+    if (m_hitTestWindows.empty()) {
+        auto bounds = m_rootWindow->getScreenRect();
+        m_hitTestGrid = HitTestGrid(bounds);
+        m_rootWindow->addToHitTestGrid(m_hitTestGrid, m_hitTestWindows, bounds);
     }
 
-    if (action == "size-right") {
-        getRect().size.width += 1;
-        return true;
+    auto id = m_hitTestGrid.find(screenPoint);
+    if (!id)
+        return tl::nullopt;
+    return m_hitTestWindows[static_cast<size_t>(*id)];
+}
+
+void Window::invalidate(Rect rect) {
+    rect.move(getScreenRect().topLeft.asSize());
+    m_windowManager->invalidate(rect);
+}
+
+bool Window::isFocused() const {
+    auto focusedWindow = m_windowManager->getFocusedWindow();
+    return focusedWindow && (*focusedWindow == this);
+}
+
+/// Snapshot of a BasicWindow.
+/// Message is shared with the shaped text cache, so it's not copied.
+class BasicWindowSnapshot : public WindowSnapshot {
+public:
+    using WindowSnapshot::WindowSnapshot;
+
+    bool doubleEdge;
+    Attributes frameAttributes;
+    Attributes messageAttributes;
+    std::shared_ptr<const ShapedText> message;
+
+private:
+    void drawSelf(ScreenCanvas& windowCanvas) const override {
+        auto localRect = Rect{Point{0, 0}, rect.size};
+        windowCanvas.fillRect(localRect, doubleEdge, true, frameAttributes);
+
+        auto point = localRect.center();
+        point.x = (localRect.size.width - message->width) / 2 - 1;
+        point.y--;
+        auto textCanvas = windowCanvas.getSubCanvas({{1, 1}, Size{localRect.size.width - 2, localRect.size.height - 2}});
+        textCanvas.print(point, message->graphemes, messageAttributes, messageAttributes, messageAttributes);
     }
+};
 
-    if (action == "size-up") {
-        getRect().size.height -= 1;
-        return true;
+WindowSnapshot* BasicWindow::snapshotSelf(const Region& dirtyRegion, FrameArena& arena) const {
+    ZUNUSED(dirtyRegion);
+    auto windowSnapshot = arena.create<BasicWindowSnapshot>(arena);
+    windowSnapshot->doubleEdge = m_doubleEdge;
+    windowSnapshot->frameAttributes = m_attributes;
+    if (isFocused()) {
+        windowSnapshot->frameAttributes.fgColor = Color::Bright_Red;
     }
+    windowSnapshot->messageAttributes = m_attributes;
+    windowSnapshot->message = shapeText(m_message);
+    return windowSnapshot;
+}
 
-    if (action == "size-down") {
-        getRect().size.height += 1;
+bool BasicWindow::doProcessAction(ActionId action) {
+    if (getActionTable().dispatch(*this, action))
         return true;
-    }
 
     return Window::doProcessAction(action);
 }
 
+const ActionTable<BasicWindow>& BasicWindow::getActionTable() {
+    static const auto actionTable = []() {
+        ActionTable<BasicWindow> table;
+
+        table.add("left", [](BasicWindow& window) { window.moveBy(Size{-1, 0}); });
+        table.add("right", [](BasicWindow& window) { window.moveBy(Size{1, 0}); });
+        table.add("up", [](BasicWindow& window) { window.moveBy(Size{0, -1}); });
+        table.add("down", [](BasicWindow& window) { window.moveBy(Size{0, 1}); });
+        table.add("size-left", [](BasicWindow& window) { window.resizeBy(Size{-1, 0}); });
+        table.add("size-right", [](BasicWindow& window) { window.resizeBy(Size{1, 0}); });
+        table.add("size-up", [](BasicWindow& window) { window.resizeBy(Size{0, -1}); });
+        table.add("size-down", [](BasicWindow& window) { window.resizeBy(Size{0, 1}); });
+
+        return table;
+    }();
+    return actionTable;
+}
+
 Window* messageBox(Window* parent, const std::string& message) {
-    auto width = getRenderedWidth(message) + 4;
+    auto width = shapeText(message)->width + 4;
     auto height = 3;
 
     auto rect = parent->getScreenRect();
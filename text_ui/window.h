@@ -6,10 +6,14 @@
 #include "text_renderer.h"
 #include "screen_buffer.h"
 #include "geometry.h"
+#include "frame_arena.h"
+#include "hit_test_grid.h"
+#include "action_table.h"
 #include "terminal_io.h"
 
 #include <algorithm>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <tl/optional.hpp>
@@ -18,14 +22,52 @@ namespace terminal_editor {
 
 class WindowManager;
 
+/// Immutable copy of everything that is needed to draw a Window and it's children.
+/// Snapshot doesn't refer to the Window, so it can be drawn on the render thread while the Window is being modified.
+/// Snapshots are made in a FrameArena, which owns them, so taking them doesn't allocate memory once the arena has grown.
+/// @note Windows are opaque: drawSelf() must paint every cell of the window.
+class WindowSnapshot {
+public:
+    Rect rect;  ///< Window position, relative to parent.
+    ArenaVector<const WindowSnapshot*> children;   ///< Snapshots of children, owned by the same arena.
+
+    explicit WindowSnapshot(FrameArena& arena)
+        : children(ArenaAllocator<const WindowSnapshot*>(arena)) {
+    }
+
+    virtual ~WindowSnapshot() = default;
+
+    /// Draws this window and it's children, but only inside given region.
+    /// Children are drawn over their parent, and later siblings over earlier ones. Parts of windows covered by
+    /// windows drawn later are not drawn at all: fully covered windows are skipped, and partially covered ones are clipped.
+    /// @param dirtyRegion  Part of the screen to redraw, in screen coordinates. Everything else is left as it is.
+    void draw(ScreenCanvas& parentCanvas, const Region& dirtyRegion) const;
+
+private:
+    /// Window with it's canvas, clipped to the window and all it's parents.
+    struct DrawItem {
+        const WindowSnapshot* window;
+        ScreenCanvas canvas;
+    };
+
+    /// Appends this window and it's children to items, in drawing order.
+    void collectDrawItems(ScreenCanvas& parentCanvas, ArenaVector<DrawItem>& items) const;
+
+    /// windowCanvas has origin in top left corner of the window.
+    virtual void drawSelf(ScreenCanvas& windowCanvas) const = 0;
+};
+
 class Window {
 private:
     WindowManager* m_windowManager; ///< Reference to the WindowManager that is coordinating this window. All windows must die before their windows manager.
     std::string m_name;             ///< Name of this window. Debug only. Doesn't have to be unique. (This is not the same thing as window title.)
     Window* m_parent;               ///< Parent of the Window. Can be nullptr only for windows that are not chilren of another window.
     Rect m_rect;                    ///< Window position, relative to parent.
+    Rect m_screenRect;              ///< Window position in screen coordinates. Updated whenever position of this window or it's ancestors changes.
     std::vector<std::unique_ptr<Window>> m_children;
 
+    friend class WindowManager;
+
 public:
     /// Notifies Window Manager that Window is created.
     Window(WindowManager* windowManager, const std::string& name, Rect rect);
@@ -61,7 +103,9 @@ public:
         childPtr->m_parent = this;
 
         // Make child position relative to parent.
-        childPtr->getRect().move(-getScreenRect().topLeft.asSize());
+        childPtr->m_rect.move(-getScreenRect().topLeft.asSize());
+        childPtr->layoutChanged();
+        childPtr->invalidate();
         return childPtr;
     }
 
@@ -75,75 +119,82 @@ public:
         auto position = std::find_if(m_children.begin(), m_children.end(), [child](const auto& ptr) { return ptr.get() == static_cast<Window*>(child); });
         ZASSERT(position != m_children.end());
 
+        child->invalidate();
+
         auto childPtr = std::move(*position);
         childPtr->m_parent = nullptr;
 
         // Make child position absolute.
-        childPtr->getRect().move(getScreenRect().topLeft.asSize());
+        childPtr->m_rect.move(getScreenRect().topLeft.asSize());
 
         m_children.erase(position);
+        childPtr->layoutChanged();
 
         childPtr.release();
         return std::unique_ptr<WindowType>(child);
     }
 
-    /// Returns range of this window's children.
-    /// Returned range is valid as long as this window's children collection is not modified.
-    auto children() {
-        // @todo Rewrite using ranges.
-        std::vector<Window*> kids;
-        for (auto& child : m_children) {
-            kids.push_back(child.get());
-        }
-        return kids;
-    }
-
     Rect getRect() const {
         return m_rect;
     }
 
-    Rect& getRect() {
-        return m_rect;
-    }
-
+    /// Moves or resizes this window. Both old and new place of the window are invalidated.
     void setRect(Rect rect) {
+        invalidate();
         m_rect = rect;
+        layoutChanged();
+        invalidate();
     }
 
-    /// Returns rectangle of this Window in screen coordinates.
-    Rect getScreenRect() const {
+    /// Moves this window by given offset.
+    void moveBy(Size offset) {
         auto rect = m_rect;
-        if (m_parent) {
-            auto parentRect = m_parent->getScreenRect();
-            rect.topLeft += parentRect.topLeft.asSize();
-        }
-        return rect;
+        rect.move(offset);
+        setRect(rect);
     }
 
-    /// Returns window under given point (in parent coordinates).
-    /// If many windows are overlapping the point, one of them will be chosen, but children have precedence over parents.
-    /// Returns nullopt if no window is under given point.
-    tl::optional<Window*> getWindowForPoint(Point point) {
-        if (!m_rect.contains(point))
-            return tl::nullopt;
+    /// Changes size of this window by given amount.
+    void resizeBy(Size delta) {
+        auto rect = m_rect;
+        rect.size += delta;
+        setRect(rect);
+    }
 
-        for (auto& child : m_children) {
-            auto window = child->getWindowForPoint(point - getRect().topLeft.asSize());
-            if (window)
-                return window;
-        }
+    /// Marks whole window as needing redraw.
+    void invalidate() {
+        invalidate(Rect{Point{0, 0}, m_rect.size});
+    }
 
-        return this;
+    /// Marks given part of the window as needing redraw.
+    /// Windows must call it whenever something they draw changes.
+    /// @param rect     Rectangle in window coordinates.
+    void invalidate(Rect rect);
+
+    /// Returns rectangle of this Window in screen coordinates.
+    Rect getScreenRect() const {
+        return m_screenRect;
     }
 
-    void draw(ScreenCanvas& parentCanvas) {
-        auto windowCanvas = parentCanvas.getSubCanvas(getRect());
-        drawSelf(windowCanvas);
-        for (auto& child : m_children) {
-            child->draw(windowCanvas);
-        }
+    /// Draws this window and it's children.
+    void draw(ScreenCanvas& parentCanvas) const {
+        Region dirtyRegion(parentCanvas.getClipRect());
+        snapshot(dirtyRegion, parentCanvas.getFrameArena())->draw(parentCanvas, dirtyRegion);
+    }
+
+    /// Returns snapshot of this window and it's children, that can draw given region.
+    /// Windows outside of the region are not drawn, so they are represented only by their rectangles.
+    /// @param dirtyRegion  Part of the screen that will be drawn, in screen coordinates.
+    /// @param arena        Arena that snapshot is made in. Snapshot is valid until the arena is reset.
+    const WindowSnapshot* snapshot(const Region& dirtyRegion, FrameArena& arena) const;
+
+    /// Returns position of the hardware cursor in screen coordinates, if this window shows it.
+    virtual tl::optional<Point> getCursorPosition() const {
+        return tl::nullopt;
     }
 
+    /// Returns true if this window has focus.
+    bool isFocused() const;
+
     /// Returns name of the input context used to process key maps.
     virtual std::string getInputContextName() const {
         return "global";
@@ -190,7 +241,7 @@ public:
         return false;
     }
 
-    bool processAction(const std::string& action) {
+    bool processAction(ActionId action) {
         if (m_parent) {
             if (m_parent->preProcessAction(action))
                 return true;
@@ -211,16 +262,31 @@ public:
     }
 
 private:
-    /// windowCanvas has origin in top left corner of this window.
-    virtual void drawSelf(ScreenCanvas& windowCanvas) = 0;
+    /// Updates screen rectangles of this window and it's descendants, and tells window manager that windows have moved.
+    void layoutChanged();
+
+    /// Updates screen rectangles of this window and it's descendants.
+    void updateScreenRect();
+
+    /// Adds visible parts of this window and it's descendants to the grid, in drawing order.
+    /// @param clipRect     Part of the screen that this window can draw on, in screen coordinates.
+    /// @param windows      Window of each rectangle added to the grid.
+    void addToHitTestGrid(HitTestGrid& grid, std::vector<Window*>& windows, Rect clipRect);
+
+    /// Returns snapshot of this window, without rect and children. Snapshot must be made with arena.create().
+    /// @param dirtyRegion  Part of the screen that will be drawn. Window can skip copying state that is drawn only outside of it.
+    virtual WindowSnapshot* snapshotSelf(const Region& dirtyRegion, FrameArena& arena) const = 0;
+
+    /// Returns handlers of actions common to all windows.
+    static const ActionTable<Window>& getActionTable();
 
 protected:
-    virtual bool preProcessAction(const std::string& action) {
+    virtual bool preProcessAction(ActionId action) {
         ZUNUSED(action);
         return false;
     }
 
-    virtual bool doProcessAction(const std::string& action);
+    virtual bool doProcessAction(ActionId action);
 
     virtual bool preProcessTextInput(const std::string& text) {
         ZUNUSED(text);
@@ -260,19 +326,26 @@ public:
 
     void setMessage(const std::string& message) {
         m_message = message;
+        invalidate();
     }
 
 private:
-    void drawSelf(ScreenCanvas& windowCanvas) override;
+    WindowSnapshot* snapshotSelf(const Region& dirtyRegion, FrameArena& arena) const override;
+
+    /// Returns handlers of actions that move and resize basic windows.
+    static const ActionTable<BasicWindow>& getActionTable();
 
 protected:
-    bool doProcessAction(const std::string& action) override;
+    bool doProcessAction(ActionId action) override;
 };
 
 class WindowManager {
     std::unique_ptr<Window> m_rootWindow;
     std::vector<Window*> m_debugWindows;
     tl::optional<Window*> m_focusedWindow;
+    Region m_invalidRegion;     ///< Parts of the screen that have to be redrawn, in screen coordinates.
+    HitTestGrid m_hitTestGrid;              ///< Visible parts of all windows in the tree, in drawing order.
+    std::vector<Window*> m_hitTestWindows;  ///< Window of each rectangle in m_hitTestGrid. Empty if windows have moved since the grid was built.
 
 public:
     WindowManager()
@@ -294,10 +367,41 @@ public:
         return m_focusedWindow;
     }
 
+    /// Moves focus to given window. Both windows are invalidated, because focused window is drawn differently.
     void setFocusedWindow(Window* window) {
         ZASSERT(window->getWindowManager() == this);
 
+        if (m_focusedWindow && *m_focusedWindow) {
+            (*m_focusedWindow)->invalidate();
+        }
         m_focusedWindow = window;
+        window->invalidate();
+    }
+
+    /// Returns position of the hardware cursor shown by the focused window, in screen coordinates.
+    tl::optional<Point> getCursorPosition() const {
+        if (!m_focusedWindow || !*m_focusedWindow)
+            return tl::nullopt;
+        return (*m_focusedWindow)->getCursorPosition();
+    }
+
+    /// Returns topmost window under given point, or nullopt if no window is under given point.
+    /// Windows are clipped by their ancestors, so only parts of windows that are drawn are found.
+    /// @param screenPoint  Point in screen coordinates.
+    tl::optional<Window*> getWindowForPoint(Point screenPoint);
+
+    /// Marks given part of the screen as needing redraw.
+    void invalidate(Rect screenRect) {
+        m_invalidRegion.add(screenRect);
+    }
+
+    bool hasInvalidRegion() const {
+        return !m_invalidRegion.isEmpty();
+    }
+
+    /// Returns parts of the screen that have to be redrawn, and forgets them.
+    Region takeInvalidRegion() {
+        return std::exchange(m_invalidRegion, Region());
     }
 
 private:
@@ -309,9 +413,16 @@ private:
         m_debugWindows.push_back(window);
     }
 
+    /// Called when windows are moved, added to the tree, or removed from it.
+    void layoutChanged() {
+        m_hitTestWindows.clear();
+    }
+
     void windowDestroyed(Window* window) {
         ZASSERT(window->getWindowManager() == this);
 
+        layoutChanged();
+
         if (m_focusedWindow == window) {
             m_focusedWindow = tl::nullopt;
         }
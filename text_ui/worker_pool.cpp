@@ -0,0 +1,84 @@
+#include "worker_pool.h"
+
+#include <utility>
+
+namespace terminal_editor {
+
+WorkerPool::WorkerPool(int threadCount)
+    : m_task(nullptr)
+    , m_taskCount(0)
+    , m_nextIndex(0)
+    , m_running(0)
+    , m_stop(false) {
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&WorkerPool::loop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(int count, const Task& task) {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_task = &task;
+    m_taskCount = count;
+    m_nextIndex = 0;
+    m_error = nullptr;
+    m_cv.notify_all();
+
+    work(lock);
+    m_cv.wait(lock, [this]() { return m_running == 0; });
+
+    m_task = nullptr;
+    if (m_error) {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+void WorkerPool::loop() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+        m_cv.wait(lock, [this]() { return (m_task && (m_nextIndex < m_taskCount)) || m_stop; });
+        if (m_stop)
+            break;
+
+        work(lock);
+    }
+}
+
+void WorkerPool::work(std::unique_lock<std::mutex>& lock) {
+    while (m_task && (m_nextIndex < m_taskCount)) {
+        auto index = m_nextIndex++;
+        ++m_running;
+        const auto& task = *m_task;
+
+        lock.unlock();
+        try {
+            task(index);
+            lock.lock();
+        }
+        catch (...) {
+            lock.lock();
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+            // Skip parts that didn't start yet.
+            m_nextIndex = m_taskCount;
+        }
+
+        --m_running;
+        if (m_running == 0) {
+            m_cv.notify_all();
+        }
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace terminal_editor {
+
+/// WorkerPool runs independent parts of a job on several threads.
+/// Calling thread works on the job too, so a pool without threads runs everything on the calling thread.
+/// @note Only one job can run at a time, so run() must not be called from more than one thread at once.
+class WorkerPool {
+public:
+    /// Task processes one part of a job.
+    /// @param index    Index of the part, from 0 to number of parts - 1.
+    using Task = std::function<void(int index)>;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;   ///< Signalled when a job starts, when a part of it is done, and on stop.
+    const Task* m_task;             ///< Task of the current job, or nullptr if there is no job.
+    int m_taskCount;                ///< Number of parts of the current job.
+    int m_nextIndex;                ///< Index of the next part that nobody works on yet.
+    int m_running;                  ///< Number of parts being processed.
+    bool m_stop;                    ///< Tells worker threads to exit.
+    std::exception_ptr m_error;     ///< First error thrown by a task of the current job.
+    std::vector<std::thread> m_threads; ///< This must be last to make sure threads start after all members are initialized.
+
+public:
+    /// @param threadCount  Number of threads to start, besides the calling thread.
+    explicit WorkerPool(int threadCount);
+
+    /// Stops all worker threads.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// Returns number of worker threads, not counting the thread calling run().
+    int getThreadCount() const {
+        return static_cast<int>(m_threads.size());
+    }
+
+    /// Calls task for each index from 0 to count - 1, in parallel, and waits until all calls are done.
+    /// If any call throws, parts that didn't start yet are skipped, and the first error is rethrown.
+    void run(int count, const Task& task);
+
+private:
+    /// Thread function.
+    void loop();
+
+    /// Processes parts of the current job until none are left.
+    /// @param lock     Lock of m_mutex. It is released while a task runs.
+    void work(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace terminal_editor
@@ -0,0 +1,74 @@
+#include "frame_arena.h"
+
+#include "zerrors.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace terminal_editor {
+
+FrameArena::FrameArena(size_t blockSize)
+    : m_blockSize(blockSize)
+    , m_capacity(0)
+    , m_currentSize(0)
+    , m_currentUsed(0)
+    , m_frameDemand(0)
+    , m_destructors(nullptr) {
+    ZASSERT(blockSize > 0) << "Frame arena blocks must not be empty.";
+}
+
+FrameArena::~FrameArena() {
+    destroyObjects();
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    ZASSERT((alignment > 0) && ((alignment & (alignment - 1)) == 0)) << "Alignment must be a power of two: " << alignment;
+
+    auto paddingAt = [alignment](const char* address) {
+        return (alignment - (reinterpret_cast<uintptr_t>(address) & (alignment - 1))) & (alignment - 1);
+    };
+
+    m_frameDemand += size + alignment - 1;
+
+    auto current = m_blocks.empty() ? nullptr : m_blocks.back().get();
+    auto padding = paddingAt(current + m_currentUsed);
+    if (!current || (m_currentUsed + padding + size > m_currentSize)) {
+        addBlock(size + alignment);
+        current = m_blocks.back().get();
+        padding = paddingAt(current);
+    }
+
+    auto result = current + m_currentUsed + padding;
+    m_currentUsed += padding + size;
+    return result;
+}
+
+void FrameArena::reset() {
+    destroyObjects();
+    if (m_blocks.size() > 1) {
+        auto capacity = std::max(m_capacity, m_frameDemand);
+        m_blocks.clear();
+        m_capacity = 0;
+        addBlock(capacity);
+    }
+    m_currentUsed = 0;
+    m_frameDemand = 0;
+}
+
+void FrameArena::addBlock(size_t size) {
+    size = std::max(size, m_blockSize);
+    m_blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+    m_capacity += size;
+    m_currentSize = size;
+    m_currentUsed = 0;
+}
+
+void FrameArena::destroyObjects() {
+    while (m_destructors) {
+        auto destructor = m_destructors;
+        m_destructors = destructor->next;
+        destructor->destroy(destructor->object);
+    }
+}
+
+} // namespace terminal_editor
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace terminal_editor {
+
+/// FrameArena is a bump allocator for short-lived data of a single frame.
+/// Memory is never freed separately, all of it is released at once by reset().
+/// Blocks are kept between frames, so once arena has grown, data of a frame doesn't allocate memory.
+/// @note FrameArena is not thread safe.
+class FrameArena {
+    /// Destroys an object made by create().
+    struct Destructor {
+        void (*destroy)(void* object);
+        void* object;
+        Destructor* next;
+    };
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;  ///< Blocks used in the current frame. Last one is the current block.
+    size_t m_blockSize;     ///< Size of the first block, and minimal size of next blocks.
+    size_t m_capacity;      ///< Sum of sizes of all blocks.
+    size_t m_currentSize;   ///< Size of the current block.
+    size_t m_currentUsed;   ///< Number of bytes used in the current block.
+    size_t m_frameDemand;   ///< Bytes requested in this frame, with worst case alignment padding. Padding depends on addresses, so it changes when blocks are merged.
+    Destructor* m_destructors;  ///< Objects made by create() in this frame, last made first.
+
+public:
+    /// @param blockSize    Size of the first block. Blocks are allocated on first use.
+    explicit FrameArena(size_t blockSize = 64 * 1024);
+
+    /// Destroys objects made by create().
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /// Returns memory for given number of bytes, aligned to given alignment.
+    /// @param alignment    Must be a power of two.
+    void* allocate(size_t size, size_t alignment);
+
+    /// Makes an object in this arena. Object is destroyed by reset(), so it must not be destroyed otherwise.
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        if (std::is_trivially_destructible<T>::value)
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        // Destructor is allocated first, so if allocation fails there is no object that won't be destroyed.
+        auto destructor = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+        auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        *destructor = Destructor{[](void* pointer) { static_cast<T*>(pointer)->~T(); }, object, m_destructors};
+        m_destructors = destructor;
+        return object;
+    }
+
+    /// Destroys objects made by create(), and releases all memory allocated in this frame.
+    /// If frame needed more than one block, they are replaced by one block that fits them all, so next frame needs only one block.
+    void reset();
+
+    /// Returns number of bytes that this arena owns.
+    size_t getCapacity() const {
+        return m_capacity;
+    }
+
+private:
+    /// Makes new current block of at least given size.
+    void addBlock(size_t size);
+
+    /// Destroys objects made by create(), last made first.
+    void destroyObjects();
+};
+
+/// Allocator for standard containers that allocates from a FrameArena.
+/// Deallocation does nothing, memory is reclaimed by FrameArena::reset().
+template<typename T>
+class ArenaAllocator {
+    template<typename U>
+    friend class ArenaAllocator;
+
+    FrameArena* m_arena;
+
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.m_arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return m_arena == other.m_arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return m_arena != other.m_arena;
+    }
+};
+
+/// Vector that allocates from a FrameArena.
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/// FrameArenaPool lends arenas to frames that are drawn on another thread, and outlive the code that made them.
+/// Frame keeps it's arena alive by holding the pointer. Arena is reset when it is lent again, after all frames dropped it.
+/// @note Arenas must be acquired by one thread, but frames can drop them on any thread.
+class FrameArenaPool {
+    std::vector<std::shared_ptr<FrameArena>> m_arenas;
+
+public:
+    /// Returns an empty arena that no frame uses. New arena is made only if all arenas are used.
+    std::shared_ptr<FrameArena> acquire() {
+        for (auto& arena : m_arenas) {
+            if (arena.use_count() == 1) {
+                // Frame dropped the arena after it's last use, so it's writes must be visible before arena is reused.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                arena->reset();
+                return arena;
+            }
+        }
+        m_arenas.push_back(std::make_shared<FrameArena>());
+        return m_arenas.back();
+    }
+};
+
+} // namespace terminal_editor
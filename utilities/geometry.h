@@ -1,6 +1,11 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace terminal_editor {
 
@@ -169,4 +174,123 @@ struct Rect {
     }
 };
 
+/// Region is a set of cells, kept as a list of disjoint rectangles.
+/// @param Allocator    Allocator of the rectangles. Regions made while drawing a frame use ArenaAllocator.
+template<typename Allocator = std::allocator<Rect>>
+class BasicRegion {
+    std::vector<Rect, Allocator> m_rects;
+
+public:
+    BasicRegion() = default;
+    explicit BasicRegion(const Allocator& allocator) : m_rects(allocator) {}
+    explicit BasicRegion(Rect rect, const Allocator& allocator = Allocator()) : m_rects(allocator) {
+        if (!rect.isEmpty())
+            m_rects.push_back(rect);
+    }
+
+    const std::vector<Rect, Allocator>& rects() const {
+        return m_rects;
+    }
+
+    bool isEmpty() const {
+        return m_rects.empty();
+    }
+
+    /// Adds cells of given rectangle to this region.
+    /// Rectangles that together form a rectangle are merged, so adding the same cells again and again doesn't grow the region.
+    void add(Rect rect) {
+        if (rect.isEmpty())
+            return;
+        for (auto regionRect : m_rects) {
+            if (regionRect.contains(rect))
+                return;
+        }
+        subtract(rect);
+        m_rects.push_back(rect);
+        mergeRects();
+    }
+
+    /// Returns cells of this region that are inside given rectangle.
+    BasicRegion intersect(Rect rect) const {
+        BasicRegion region(m_rects.get_allocator());
+        for (auto regionRect : m_rects) {
+            auto common = regionRect.intersect(rect);
+            if (!common.isEmpty())
+                region.m_rects.push_back(common);
+        }
+        return region;
+    }
+
+    /// Removes cells of given rectangle from this region.
+    /// Every rectangle that overlaps the hole is split into at most four rectangles around it.
+    /// Rectangles are split in place, so once the region has grown it doesn't allocate memory.
+    void subtract(Rect hole) {
+        for (size_t i = 0; i < m_rects.size(); ) {
+            auto rect = m_rects[i];
+            auto common = rect.intersect(hole);
+            if (common.isEmpty()) {
+                ++i;
+                continue;
+            }
+
+            auto top = Rect(rect.topLeft, Point(rect.bottomRight().x, common.topLeft.y));
+            auto bottom = Rect(Point(rect.topLeft.x, common.bottomRight().y), rect.bottomRight());
+            auto left = Rect(Point(rect.topLeft.x, common.topLeft.y), Point(common.topLeft.x, common.bottomRight().y));
+            auto right = Rect(Point(common.bottomRight().x, common.topLeft.y), Point(rect.bottomRight().x, common.bottomRight().y));
+            Rect parts[4];
+            size_t partCount = 0;
+            for (auto part : {top, bottom, left, right}) {
+                if (!part.isEmpty())
+                    parts[partCount++] = part;
+            }
+
+            // Parts take the place of the split rectangle. They don't overlap the hole, so they are skipped.
+            auto position = m_rects.begin() + static_cast<std::ptrdiff_t>(i);
+            if (partCount == 0) {
+                m_rects.erase(position);
+                continue;
+            }
+            *position = parts[0];
+            m_rects.insert(position + 1, parts + 1, parts + partCount);
+            i += partCount;
+        }
+    }
+
+private:
+    /// Merges pairs of rectangles that touch along a whole edge, until no such pairs are left.
+    void mergeRects() {
+        for (size_t i = 0; i < m_rects.size(); ) {
+            bool merged = false;
+            for (size_t j = i + 1; j < m_rects.size(); ++j) {
+                if (tryMerge(m_rects[i], m_rects[j])) {
+                    m_rects.erase(m_rects.begin() + static_cast<std::ptrdiff_t>(j));
+                    merged = true;
+                    break;
+                }
+            }
+            // Merged rectangle can now touch rectangles that were already checked.
+            i = merged ? 0 : i + 1;
+        }
+    }
+
+    /// If union of two disjoint rectangles is a rectangle, stores it in first and returns true.
+    static bool tryMerge(Rect& first, Rect second) {
+        auto firstEnd = first.bottomRight();
+        auto secondEnd = second.bottomRight();
+        bool sameColumns = (first.topLeft.x == second.topLeft.x) && (first.size.width == second.size.width);
+        bool sameRows = (first.topLeft.y == second.topLeft.y) && (first.size.height == second.size.height);
+        if (sameColumns && ((firstEnd.y == second.topLeft.y) || (secondEnd.y == first.topLeft.y))) {
+            first = Rect(Point(first.topLeft.x, std::min(first.topLeft.y, second.topLeft.y)), Point(firstEnd.x, std::max(firstEnd.y, secondEnd.y)));
+            return true;
+        }
+        if (sameRows && ((firstEnd.x == second.topLeft.x) || (secondEnd.x == first.topLeft.x))) {
+            first = Rect(Point(std::min(first.topLeft.x, second.topLeft.x), first.topLeft.y), Point(std::max(firstEnd.x, secondEnd.x), firstEnd.y));
+            return true;
+        }
+        return false;
+    }
+};
+
+using Region = BasicRegion<>;
+
 } // namespace terminal_editor